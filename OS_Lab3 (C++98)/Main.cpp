@@ -1,16 +1,164 @@
-#include <windows.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <cstdlib>
 #include <iostream>
 #include <vector>
+#ifdef LAB3_PROFILE_LOCKS
+#include <time.h>
+#endif
 
 using namespace std;
 
+#ifdef LAB3_PROFILE_LOCKS
+// Built with -DLAB3_PROFILE_LOCKS (make PROFILE=1) every lock of the shared mutex is
+// timed: how long the call waited, how long the mutex was then held and how often it
+// passed to another thread. Recorded while the mutex is held, so no extra locking.
+const int kLatencyBuckets = 48;
+
+struct LatencyHistogram
+{
+    long long counts[kLatencyBuckets];
+    long long count;
+    long long totalNs;
+    long long maxNs;
+};
+
+struct LockProfile
+{
+    LatencyHistogram wait;
+    LatencyHistogram hold;
+    long long contended;
+    long long handoffs;
+    pthread_t owner;
+    bool hasOwner;
+    long long heldSince;
+};
+
+static LockProfile lockProfile;
+
+long long monotonicNs()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<long long>(now.tv_sec) * 1000000000LL + now.tv_nsec;
+}
+
+// Bucket b holds durations below 2^b ns.
+void recordLatency(LatencyHistogram& histogram, long long ns)
+{
+    int bucket = 0;
+    while (bucket < kLatencyBuckets - 1 && (1LL << bucket) <= ns)
+    {
+        ++bucket;
+    }
+    ++histogram.counts[bucket];
+    ++histogram.count;
+    histogram.totalNs += ns;
+    if (ns > histogram.maxNs)
+    {
+        histogram.maxNs = ns;
+    }
+}
+
+long long percentileNs(const LatencyHistogram& histogram, double fraction)
+{
+    long long rank = static_cast<long long>(fraction * histogram.count);
+    long long seen = 0;
+    for (int bucket = 0; bucket < kLatencyBuckets; ++bucket)
+    {
+        seen += histogram.counts[bucket];
+        if (seen > rank)
+        {
+            return (1LL << bucket) < histogram.maxNs ? (1LL << bucket) : histogram.maxNs;
+        }
+    }
+    return histogram.maxNs;
+}
+
+void printLatency(const char* name, const LatencyHistogram& histogram)
+{
+    cout << name << " count=" << histogram.count << " total_ms=" << histogram.totalNs / 1e6
+         << " p50_ns<=" << percentileNs(histogram, 0.5) << " p90_ns<=" << percentileNs(histogram, 0.9)
+         << " p99_ns<=" << percentileNs(histogram, 0.99) << " max_ns=" << histogram.maxNs << endl;
+}
+
+void printLockProfile()
+{
+    cout << "lock_profile acquisitions=" << lockProfile.wait.count << " contended=" << lockProfile.contended
+         << " handoffs=" << lockProfile.handoffs << endl;
+    printLatency("lock_wait", lockProfile.wait);
+    printLatency("lock_hold", lockProfile.hold);
+}
+
+void noteAcquired(long long start, bool contended)
+{
+    lockProfile.heldSince = monotonicNs();
+    recordLatency(lockProfile.wait, lockProfile.heldSince - start);
+    if (contended)
+    {
+        ++lockProfile.contended;
+    }
+
+    pthread_t self = pthread_self();
+    if (lockProfile.hasOwner && !pthread_equal(self, lockProfile.owner))
+    {
+        ++lockProfile.handoffs;
+    }
+    lockProfile.owner = self;
+    lockProfile.hasOwner = true;
+}
+
+void noteReleasing()
+{
+    recordLatency(lockProfile.hold, monotonicNs() - lockProfile.heldSince);
+}
+#endif
+
+// The shared mutex goes through these so the profiled build can time it; without
+// LAB3_PROFILE_LOCKS they are the bare pthread calls.
+inline void lockShared(pthread_mutex_t& mtx)
+{
+#ifdef LAB3_PROFILE_LOCKS
+    long long start = monotonicNs();
+    bool contended = pthread_mutex_trylock(&mtx) != 0;
+    if (contended)
+    {
+        pthread_mutex_lock(&mtx);
+    }
+    noteAcquired(start, contended);
+#else
+    pthread_mutex_lock(&mtx);
+#endif
+}
+
+inline void unlockShared(pthread_mutex_t& mtx)
+{
+#ifdef LAB3_PROFILE_LOCKS
+    noteReleasing();
+#endif
+    pthread_mutex_unlock(&mtx);
+}
+
+// Sleeping on the condition is not lock contention: the hold ends before it and a new
+// one starts after it, with no wait charged.
+inline void waitShared(pthread_cond_t& cv, pthread_mutex_t& mtx)
+{
+#ifdef LAB3_PROFILE_LOCKS
+    noteReleasing();
+    pthread_cond_wait(&cv, &mtx);
+    noteAcquired(monotonicNs(), false);
+#else
+    pthread_cond_wait(&cv, &mtx);
+#endif
+}
+
 class MarkerThread
 {
 public:
-    MarkerThread(int id, std::vector<int>& array, CRITICAL_SECTION& mtx, HANDLE cvStart,
-                 std::vector<HANDLE>& cvContinue, std::vector<bool>& continueSignal,
-                 std::vector<bool>& terminateSignal, bool& startSignal)
-        : id_(id), array_(array), mtx_(mtx), cvStart_(cvStart), cvContinue_(cvContinue),
+    MarkerThread(int id, std::vector<int>& array, pthread_mutex_t& mtx, pthread_cond_t& cvStart,
+                 std::vector<pthread_cond_t>& cvContinue, pthread_cond_t& cvBlocked,
+                 std::vector<bool>& continueSignal, std::vector<bool>& terminateSignal, bool& startSignal)
+        : id_(id), array_(array), mtx_(mtx), cvStart_(cvStart), cvContinue_(cvContinue), cvBlocked_(cvBlocked),
           continueSignal_(continueSignal), terminateSignal_(terminateSignal), startSignal_(startSignal)
     {
     }
@@ -20,64 +168,58 @@ public:
         try
         {
             // Wait for start signal
-            EnterCriticalSection(&mtx_);
+            lockShared(mtx_);
             while (!startSignal_)
             {
-                LeaveCriticalSection(&mtx_);
-                WaitForSingleObject(cvStart_, INFINITE);
-                EnterCriticalSection(&mtx_);
+                waitShared(cvStart_, mtx_);
             }
-            LeaveCriticalSection(&mtx_);
+            unlockShared(mtx_);
 
             srand(id_);
 
             int markedCount = 0;
             while (true)
             {
-                EnterCriticalSection(&mtx_);
+                lockShared(mtx_);
                 if (terminateSignal_[id_ - 1])
                 {
-                    LeaveCriticalSection(&mtx_);
+                    unlockShared(mtx_);
                     break;
                 }
 
                 int randomIndex = rand() % array_.size();
                 if (array_[randomIndex] == 0)
                 {
-                    Sleep(5);
+                    usleep(5000);
                     array_[randomIndex] = id_;
-                    Sleep(5);
+                    usleep(5000);
                     ++markedCount;
-                    LeaveCriticalSection(&mtx_);
+                    unlockShared(mtx_);
                 }
                 else
                 {
                     cout << "Thread " << id_ << ": marked " << markedCount << " elements, cannot mark index " << randomIndex << endl;
+
+                    // Wake the coordinator instead of letting it poll
                     continueSignal_[id_ - 1] = false;
-                    SetEvent(cvContinue_[id_ - 1]);
-                    LeaveCriticalSection(&mtx_);
+                    pthread_cond_signal(&cvBlocked_);
 
-                    EnterCriticalSection(&mtx_);
                     while (!continueSignal_[id_ - 1] && !terminateSignal_[id_ - 1])
                     {
-                        LeaveCriticalSection(&mtx_);
-                        WaitForSingleObject(cvContinue_[id_ - 1], INFINITE);
-                        EnterCriticalSection(&mtx_);
+                        waitShared(cvContinue_[id_ - 1], mtx_);
                     }
 
                     if (terminateSignal_[id_ - 1])
                     {
-                        LeaveCriticalSection(&mtx_);
+                        unlockShared(mtx_);
                         break;
                     }
-
-                    continueSignal_[id_ - 1] = false;
-                    LeaveCriticalSection(&mtx_);
+                    unlockShared(mtx_);
                 }
             }
 
             // Clear own marks
-            EnterCriticalSection(&mtx_);
+            lockShared(mtx_);
             for (size_t i = 0; i < array_.size(); ++i)
             {
                 if (array_[i] == id_)
@@ -86,8 +228,7 @@ public:
                 }
             }
             terminateSignal_[id_ - 1] = true;
-            LeaveCriticalSection(&mtx_);
-            SetEvent(cvContinue_[id_ - 1]);
+            unlockShared(mtx_);
         }
         catch (...)
         {
@@ -98,19 +239,20 @@ public:
 private:
     int id_;
     std::vector<int>& array_;
-    CRITICAL_SECTION& mtx_;
-    HANDLE cvStart_;
-    std::vector<HANDLE>& cvContinue_;
+    pthread_mutex_t& mtx_;
+    pthread_cond_t& cvStart_;
+    std::vector<pthread_cond_t>& cvContinue_;
+    pthread_cond_t& cvBlocked_;
     std::vector<bool>& continueSignal_;
     std::vector<bool>& terminateSignal_;
     bool& startSignal_;
 };
 
-DWORD WINAPI ThreadProc(LPVOID lpParam)
+void* ThreadProc(void* param)
 {
-    MarkerThread* pMT = (MarkerThread*)lpParam;
+    MarkerThread* pMT = (MarkerThread*)param;
     (*pMT)();
-    return 0;
+    return NULL;
 }
 
 void printArray(const std::vector<int>& array)
@@ -147,13 +289,16 @@ int main()
     }
 
     // Synchronization primitives
-    CRITICAL_SECTION mtx;
-    InitializeCriticalSection(&mtx);
-    HANDLE cvStartEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
-    std::vector<HANDLE> cvContinueEvents(numThreads);
+    pthread_mutex_t mtx;
+    pthread_mutex_init(&mtx, NULL);
+    pthread_cond_t cvStart;
+    pthread_cond_init(&cvStart, NULL);
+    pthread_cond_t cvBlocked;
+    pthread_cond_init(&cvBlocked, NULL);
+    std::vector<pthread_cond_t> cvContinue(numThreads);
     for (int i = 0; i < numThreads; ++i)
     {
-        cvContinueEvents[i] = CreateEvent(NULL, FALSE, FALSE, NULL);
+        pthread_cond_init(&cvContinue[i], NULL);
     }
 
     std::vector<bool> continueSignal(numThreads, true);
@@ -161,49 +306,44 @@ int main()
     bool startSignal = false;
 
     std::vector<MarkerThread*> markerThreads;
-    std::vector<HANDLE> threadHandles;
+    std::vector<pthread_t> threadHandles(numThreads);
+    std::vector<bool> joined(numThreads, false);
 
     for (int i = 0; i < numThreads; ++i)
     {
-        MarkerThread* pMT = new MarkerThread(i + 1, array, mtx, cvStartEvent,
-                                             cvContinueEvents, continueSignal,
+        MarkerThread* pMT = new MarkerThread(i + 1, array, mtx, cvStart,
+                                             cvContinue, cvBlocked, continueSignal,
                                              terminateSignal, startSignal);
         markerThreads.push_back(pMT);
 
-        HANDLE hThread = CreateThread(NULL, 0, ThreadProc, pMT, 0, NULL);
-        if (!hThread)
+        if (pthread_create(&threadHandles[i], NULL, ThreadProc, pMT) != 0)
         {
             cerr << "Failed to create thread " << i + 1 << endl;
             delete pMT;
             return 1;
         }
-        threadHandles.push_back(hThread);
     }
 
     {
-        EnterCriticalSection(&mtx);
+        lockShared(mtx);
         startSignal = true;
-        LeaveCriticalSection(&mtx);
-        SetEvent(cvStartEvent);
+        pthread_cond_broadcast(&cvStart);
+        unlockShared(mtx);
     }
 
     bool allTerminated = false;
     while (!allTerminated)
     {
+        // Sleep until every marker has reported that it is blocked
+        lockShared(mtx);
         for (int i = 0; i < numThreads; ++i)
         {
-            while (true)
+            while (continueSignal[i])
             {
-                EnterCriticalSection(&mtx);
-                if (!continueSignal[i])
-                {
-                    LeaveCriticalSection(&mtx);
-                    break;
-                }
-                LeaveCriticalSection(&mtx);
-                Sleep(100);
+                waitShared(cvBlocked, mtx);
             }
         }
+        unlockShared(mtx);
 
         printArray(array);
 
@@ -218,21 +358,20 @@ int main()
         }
 
         int idx = threadToTerminate - 1;
-        EnterCriticalSection(&mtx);
+        lockShared(mtx);
         if (terminateSignal[idx])
         {
             cerr << "Thread " << threadToTerminate << " has already terminated." << endl;
-            LeaveCriticalSection(&mtx);
+            unlockShared(mtx);
             continue;
         }
 
         terminateSignal[idx] = true;
-        LeaveCriticalSection(&mtx);
-        SetEvent(cvContinueEvents[idx]);
+        pthread_cond_signal(&cvContinue[idx]);
+        unlockShared(mtx);
 
-        WaitForSingleObject(threadHandles[idx], INFINITE);
-        CloseHandle(threadHandles[idx]);
-        threadHandles[idx] = NULL;
+        pthread_join(threadHandles[idx], NULL);
+        joined[idx] = true;
         delete markerThreads[idx];
 
         printArray(array);
@@ -240,7 +379,7 @@ int main()
         allTerminated = true;
         for (int i = 0; i < numThreads; ++i)
         {
-            if (threadHandles[i] != NULL && !terminateSignal[i])
+            if (!joined[i])
             {
                 allTerminated = false;
                 break;
@@ -249,26 +388,31 @@ int main()
 
         if (!allTerminated)
         {
-            EnterCriticalSection(&mtx);
+            lockShared(mtx);
             for (int i = 0; i < numThreads; ++i)
             {
                 if (!terminateSignal[i])
                 {
                     continueSignal[i] = true;
-                    SetEvent(cvContinueEvents[i]);
+                    pthread_cond_signal(&cvContinue[i]);
                 }
             }
-            LeaveCriticalSection(&mtx);
+            unlockShared(mtx);
         }
     }
 
+#ifdef LAB3_PROFILE_LOCKS
+    printLockProfile();
+#endif
+
     // Cleanup
-    CloseHandle(cvStartEvent);
+    pthread_cond_destroy(&cvStart);
+    pthread_cond_destroy(&cvBlocked);
     for (int i = 0; i < numThreads; ++i)
     {
-        CloseHandle(cvContinueEvents[i]);
+        pthread_cond_destroy(&cvContinue[i]);
     }
-    DeleteCriticalSection(&mtx);
+    pthread_mutex_destroy(&mtx);
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,141 @@
+#pragma once
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <iostream>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+#include "shared_array.h"
+
+// Formats the array as "n n n \n" into reusable per-chunk buffers. Large arrays are
+// split into chunks formatted by several threads, then written in order, one write
+// per chunk.
+class ArrayRenderer
+{
+public:
+    static const size_t ChunkCells = 1 << 16;
+    static const size_t MaxCellChars = 12;
+
+    explicit ArrayRenderer(unsigned workers = std::thread::hardware_concurrency())
+        : workers_(workers == 0 ? 1 : workers)
+    {
+    }
+
+    template <typename Cell>
+    void render(const BasicSharedArray<Cell>& array, std::ostream& out)
+    {
+        format(array);
+        if (&out == &std::cout)
+        {
+            std::cout.flush();
+            std::fflush(stdout);
+            for (size_t c = 0; c < chunkCount_; ++c)
+            {
+                writeAll(buffers_[c].data(), lengths_[c]);
+            }
+            return;
+        }
+
+        for (size_t c = 0; c < chunkCount_; ++c)
+        {
+            out.write(buffers_[c].data(), static_cast<std::streamsize>(lengths_[c]));
+        }
+    }
+
+private:
+    template <typename Cell>
+    void format(const BasicSharedArray<Cell>& array)
+    {
+        chunkCount_ = (array.size() + ChunkCells - 1) / ChunkCells;
+        // The last chunk also carries the trailing newline.
+        if (chunkCount_ == 0)
+        {
+            chunkCount_ = 1;
+        }
+        if (buffers_.size() < chunkCount_)
+        {
+            buffers_.resize(chunkCount_);
+            lengths_.resize(chunkCount_);
+        }
+
+        size_t threads = std::min<size_t>(workers_, chunkCount_);
+        if (threads <= 1)
+        {
+            formatChunks(array, 0, 1);
+        }
+        else
+        {
+            std::vector<std::thread> pool;
+            for (size_t t = 1; t < threads; ++t)
+            {
+                pool.emplace_back([this, &array, t, threads] { formatChunks(array, t, threads); });
+            }
+            formatChunks(array, 0, threads);
+            for (auto& worker : pool)
+            {
+                worker.join();
+            }
+        }
+    }
+
+    template <typename Cell>
+    void formatChunks(const BasicSharedArray<Cell>& array, size_t first, size_t stride)
+    {
+        for (size_t c = first; c < chunkCount_; c += stride)
+        {
+            size_t begin = c * ChunkCells;
+            size_t end = std::min(begin + ChunkCells, array.size());
+            std::vector<char>& buffer = buffers_[c];
+            buffer.resize((end - begin) * MaxCellChars + 1);
+
+            char* cursor = buffer.data();
+            char* limit = buffer.data() + buffer.size();
+            for (size_t i = begin; i < end; ++i)
+            {
+                cursor = std::to_chars(cursor, limit, array.load(i)).ptr;
+                *cursor++ = ' ';
+            }
+            if (c + 1 == chunkCount_)
+            {
+                *cursor++ = '\n';
+            }
+            lengths_[c] = static_cast<size_t>(cursor - buffer.data());
+        }
+    }
+
+    static void writeAll(const char* data, size_t length)
+    {
+        while (length > 0)
+        {
+#ifdef _WIN32
+            int written = _write(1, data, static_cast<unsigned>(length));
+#else
+            ssize_t written = ::write(STDOUT_FILENO, data, length);
+#endif
+            if (written <= 0)
+            {
+                return;
+            }
+            data += written;
+            length -= static_cast<size_t>(written);
+        }
+    }
+
+    unsigned workers_;
+    size_t chunkCount_ = 0;
+    std::vector<std::vector<char>> buffers_;
+    std::vector<size_t> lengths_;
+};
+
+template <typename Cell>
+void printArray(const BasicSharedArray<Cell>& array, std::ostream& out = std::cout)
+{
+    static ArrayRenderer renderer;
+    renderer.render(array, out);
+    out.flush();
+}
@@ -0,0 +1,128 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include "marker_counters.h"
+#include "profiled_mutex.h"
+
+enum class VictimCost
+{
+    FewestMarks,
+    Youngest
+};
+
+inline const char* victimCostName(VictimCost cost)
+{
+    return cost == VictimCost::Youngest ? "youngest" : "fewest";
+}
+
+struct DeadlockCycle
+{
+    std::vector<int> members;
+    std::chrono::steady_clock::time_point detectedAt;
+};
+
+// Wait-for graph over the markers: a blocked marker has one edge, to the owner of the
+// cell it could not mark, and it can only go on once that owner has released its cells.
+// Every node has at most one outgoing edge, so the cycle a new edge closes is found by
+// walking from the owner back to the waiter. A marker waiting on its own cell is a
+// cycle of one. All methods are called with the run's shared mutex held.
+class DeadlockDetector
+{
+public:
+    explicit DeadlockDetector(int markers)
+        : waitsFor_(markers + 1, 0), detected_(0)
+    {
+    }
+
+    // Marker side. False when the owner is already 0, i.e. the cell came free in the
+    // meantime and there is nothing to wait for.
+    bool block(int waiter, int owner)
+    {
+        if (owner == 0)
+        {
+            return false;
+        }
+
+        waitsFor_[waiter] = owner;
+        int node = owner;
+        for (size_t steps = 0; node != 0 && steps < waitsFor_.size(); ++steps)
+        {
+            if (node == waiter)
+            {
+                DeadlockCycle cycle;
+                cycle.detectedAt = std::chrono::steady_clock::now();
+                int member = waiter;
+                do
+                {
+                    cycle.members.push_back(member);
+                    member = waitsFor_[member];
+                } while (member != waiter);
+
+                pending_.push_back(cycle);
+                ++detected_;
+                cvCycle_.notify_one();
+                break;
+            }
+            node = waitsFor_[node];
+        }
+        return true;
+    }
+
+    // Coordinator side: the oldest cycle not yet broken.
+    DeadlockCycle waitForCycle(RunLock& lock)
+    {
+        cvCycle_.wait(lock, [this] { return !pending_.empty(); });
+        DeadlockCycle cycle = pending_.front();
+        pending_.pop_front();
+        return cycle;
+    }
+
+    // Coordinator side, once the victim's cells are released: drops its edge and
+    // returns the markers that were waiting on it, which may go on now.
+    std::vector<int> remove(int victim)
+    {
+        waitsFor_[victim] = 0;
+        std::vector<int> released;
+        for (size_t i = 1; i < waitsFor_.size(); ++i)
+        {
+            if (waitsFor_[i] == victim)
+            {
+                waitsFor_[i] = 0;
+                released.push_back(static_cast<int>(i));
+            }
+        }
+        return released;
+    }
+
+    long long detected() const
+    {
+        return detected_;
+    }
+
+private:
+    std::vector<int> waitsFor_;
+    std::deque<DeadlockCycle> pending_;
+    RunCondition cvCycle_;
+    long long detected_;
+};
+
+// Fewest marks loses the least work; youngest is the marker started last.
+inline int chooseVictim(const DeadlockCycle& cycle, VictimCost cost, const CounterBoard& counters)
+{
+    int victim = cycle.members.front();
+    for (int member : cycle.members)
+    {
+        if (cost == VictimCost::Youngest)
+        {
+            victim = member > victim ? member : victim;
+        }
+        else if (counters.forMarker(member).marked.load() < counters.forMarker(victim).marked.load())
+        {
+            victim = member;
+        }
+    }
+    return victim;
+}
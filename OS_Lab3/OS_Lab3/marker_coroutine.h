@@ -0,0 +1,318 @@
+#pragma once
+#if defined(__cpp_impl_coroutine)
+#include <chrono>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <queue>
+#include <thread>
+#include <vector>
+#include "shared_array.h"
+#include "marker_settings.h"
+#include "ownership_journal.h"
+#include "marker_rng.h"
+
+// Owns one marker coroutine frame. The body starts right away and runs up to its first
+// co_await, the start gate.
+class MarkerCoroutine
+{
+public:
+    struct promise_type
+    {
+        MarkerCoroutine get_return_object()
+        {
+            return MarkerCoroutine(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_never initial_suspend() noexcept
+        {
+            return {};
+        }
+
+        std::suspend_always final_suspend() noexcept
+        {
+            return {};
+        }
+
+        void return_void()
+        {
+        }
+
+        void unhandled_exception()
+        {
+            std::terminate();
+        }
+    };
+
+    explicit MarkerCoroutine(std::coroutine_handle<promise_type> handle)
+        : handle_(handle)
+    {
+    }
+
+    MarkerCoroutine(MarkerCoroutine&& other) noexcept
+        : handle_(other.handle_)
+    {
+        other.handle_ = nullptr;
+    }
+
+    MarkerCoroutine(const MarkerCoroutine&) = delete;
+    MarkerCoroutine& operator=(const MarkerCoroutine&) = delete;
+
+    ~MarkerCoroutine()
+    {
+        if (handle_)
+        {
+            handle_.destroy();
+        }
+    }
+
+    bool done() const
+    {
+        return handle_.done();
+    }
+
+private:
+    std::coroutine_handle<promise_type> handle_;
+};
+
+// Single-threaded driver: a ready queue plus a timer heap. Switching markers is a
+// resume() call on the coordinator's own thread, with no futex in between.
+class CoroutineLoop
+{
+public:
+    void post(std::coroutine_handle<> handle)
+    {
+        ready_.push_back(handle);
+    }
+
+    void postAfter(std::coroutine_handle<> handle, std::chrono::microseconds delay)
+    {
+        timers_.push(Timer{ std::chrono::steady_clock::now() + delay, sequence_++, handle });
+    }
+
+    // Resumes ready markers and due timers until every marker is parked or finished.
+    void runUntilIdle()
+    {
+        while (!ready_.empty() || !timers_.empty())
+        {
+            if (ready_.empty())
+            {
+                std::this_thread::sleep_until(timers_.top().due);
+                auto now = std::chrono::steady_clock::now();
+                while (!timers_.empty() && timers_.top().due <= now)
+                {
+                    ready_.push_back(timers_.top().handle);
+                    timers_.pop();
+                }
+                continue;
+            }
+
+            std::coroutine_handle<> handle = ready_.front();
+            ready_.pop_front();
+            resume(handle);
+        }
+    }
+
+    void resume(std::coroutine_handle<> handle)
+    {
+        ++switches_;
+        handle.resume();
+    }
+
+    long long switches() const
+    {
+        return switches_;
+    }
+
+    // One of the two pauses around a mark: a timer for the sleep model, inline work
+    // for the others.
+    struct Pause
+    {
+        CoroutineLoop& loop;
+        const WorkModel& work;
+
+        bool await_ready() const
+        {
+            if (work.kind == WorkKind::Sleep)
+            {
+                return false;
+            }
+            work.perform();
+            return true;
+        }
+
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            loop.postAfter(handle, work.duration);
+        }
+
+        void await_resume() const
+        {
+        }
+    };
+
+    Pause pause(const WorkModel& work)
+    {
+        return Pause{ *this, work };
+    }
+
+private:
+    struct Timer
+    {
+        std::chrono::steady_clock::time_point due;
+        unsigned long long sequence;
+        std::coroutine_handle<> handle;
+
+        bool operator>(const Timer& other) const
+        {
+            return due != other.due ? due > other.due : sequence > other.sequence;
+        }
+    };
+
+    std::deque<std::coroutine_handle<>> ready_;
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers_;
+    unsigned long long sequence_ = 0;
+    long long switches_ = 0;
+};
+
+// Markers wait here for the start signal; open() makes all of them ready at once.
+class StartGate
+{
+public:
+    explicit StartGate(CoroutineLoop& loop)
+        : loop_(loop)
+    {
+    }
+
+    bool await_ready() const
+    {
+        return open_;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        waiting_.push_back(handle);
+    }
+
+    void await_resume() const
+    {
+    }
+
+    void open()
+    {
+        open_ = true;
+        for (auto handle : waiting_)
+        {
+            loop_.post(handle);
+        }
+        waiting_.clear();
+    }
+
+private:
+    CoroutineLoop& loop_;
+    std::vector<std::coroutine_handle<>> waiting_;
+    bool open_ = false;
+};
+
+// Where one blocked marker waits for the coordinator's continue or terminate. The
+// coordinator resumes the stored handle directly; co_await yields true on terminate.
+struct RoundSlot
+{
+    std::coroutine_handle<> waiting;
+    bool terminate = false;
+    bool finished = false;
+
+    bool await_ready() const
+    {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        waiting = handle;
+    }
+
+    bool await_resume()
+    {
+        waiting = nullptr;
+        return terminate;
+    }
+
+    bool parked() const
+    {
+        return static_cast<bool>(waiting);
+    }
+};
+
+// The marker loop with the start wait, both pauses and the continue/terminate wait as
+// co_await points. Everything runs on one thread, so a cell can change hands during a
+// pause; like the thread version's atomic mode the mark is a claim that fails then.
+template <typename Cell>
+MarkerCoroutine runMarkerCoroutine(int id, BasicSharedArray<Cell>& array, CoroutineLoop& loop, StartGate& start,
+    RoundSlot& slot, MarkerSettings settings)
+{
+    co_await start;
+
+    IndexBatch indices(static_cast<uint64_t>(id), static_cast<uint32_t>(array.size()));
+    OwnershipJournal journal;
+    MarkerCounters* counters = settings.counters != nullptr ? &settings.counters->forMarker(id) : nullptr;
+    long long markedCount = 0;
+
+    while (true)
+    {
+        size_t index = indices.next();
+        if (array.load(index) == 0)
+        {
+            co_await loop.pause(settings.work);
+            if (array.claim(index, id))
+            {
+                if (settings.occupancy != nullptr)
+                {
+                    settings.occupancy->set(index);
+                }
+                journal.record(index);
+                ++markedCount;
+                if (counters != nullptr)
+                {
+                    MarkerCounters::bump(counters->marked);
+                }
+                co_await loop.pause(settings.work);
+                continue;
+            }
+        }
+
+        if (counters != nullptr)
+        {
+            counters->noteBlocked();
+        }
+        if (settings.verbose)
+        {
+            std::cout << "Thread " << id << ": marked " << markedCount << " elements, cannot mark index " << index << std::endl;
+        }
+        if (co_await slot)
+        {
+            break;
+        }
+    }
+
+    journal.forEach([&](size_t index)
+    {
+        array.store(index, 0);
+        if (settings.occupancy != nullptr)
+        {
+            settings.occupancy->reset(index);
+        }
+    });
+    if (counters != nullptr)
+    {
+        MarkerCounters::bump(counters->released, static_cast<long long>(journal.size()));
+    }
+    if (settings.verbose)
+    {
+        std::cout << "Thread " << id << ": released " << journal.size() << " elements" << std::endl;
+    }
+    slot.finished = true;
+}
+#endif
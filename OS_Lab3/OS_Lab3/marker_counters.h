@@ -0,0 +1,118 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
+// Live per-marker statistics. Every block has a single writer (its marker), so bumps
+// are a relaxed load and store rather than a locked read-modify-write, and each block
+// sits on its own cache line so markers never invalidate each other's counters.
+struct alignas(64) MarkerCounters
+{
+    std::atomic<long long> marked{ 0 };
+    std::atomic<long long> released{ 0 };
+    std::atomic<long long> blocked{ 0 };
+    // Steady-clock nanoseconds of the latest block.
+    std::atomic<long long> blockedAt{ 0 };
+    // Time spent acquiring mutexes and waiting on condition variables; only the
+    // thread markers measure these, and only when asked to. A condition wait re-takes
+    // the shared mutex inside the wait, so that part lands in condWaitNs.
+    std::atomic<long long> lockWaitNs{ 0 };
+    std::atomic<long long> condWaitNs{ 0 };
+
+    static void bump(std::atomic<long long>& counter, long long amount = 1)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    void noteBlocked()
+    {
+        bump(blocked);
+        blockedAt.store(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count(), std::memory_order_relaxed);
+    }
+};
+
+// Adds the time until it goes out of scope to a wait counter; a no-op without one.
+class WaitTimer
+{
+public:
+    explicit WaitTimer(std::atomic<long long>* counter)
+        : counter_(counter)
+    {
+        if (counter_ != nullptr)
+        {
+            start_ = std::chrono::steady_clock::now();
+        }
+    }
+
+    WaitTimer(const WaitTimer&) = delete;
+    WaitTimer& operator=(const WaitTimer&) = delete;
+
+    ~WaitTimer()
+    {
+        if (counter_ != nullptr)
+        {
+            MarkerCounters::bump(*counter_, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start_).count());
+        }
+    }
+
+private:
+    std::atomic<long long>* counter_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+struct CounterTotals
+{
+    long long marked = 0;
+    long long released = 0;
+    long long blocked = 0;
+
+    // Cells currently owned by some marker, as far as the counters have caught up.
+    long long held() const
+    {
+        return marked - released;
+    }
+};
+
+// Counters for the whole run. Readers sum the blocks without taking any lock, so the
+// total is a snapshot that may be a few marks behind the markers.
+class CounterBoard
+{
+public:
+    explicit CounterBoard(int markers)
+        : counters_(static_cast<size_t>(markers))
+    {
+    }
+
+    MarkerCounters& forMarker(int id)
+    {
+        return counters_[id - 1];
+    }
+
+    const MarkerCounters& forMarker(int id) const
+    {
+        return counters_[id - 1];
+    }
+
+    size_t size() const
+    {
+        return counters_.size();
+    }
+
+    CounterTotals totals() const
+    {
+        CounterTotals totals;
+        for (const auto& counters : counters_)
+        {
+            totals.marked += counters.marked.load(std::memory_order_relaxed);
+            totals.released += counters.released.load(std::memory_order_relaxed);
+            totals.blocked += counters.blocked.load(std::memory_order_relaxed);
+        }
+        return totals;
+    }
+
+private:
+    std::vector<MarkerCounters> counters_;
+};
@@ -0,0 +1,23 @@
+#pragma once
+#include "shared_array.h"
+#include "striped_locks.h"
+#include "work_model.h"
+#include "round_barrier.h"
+#include "occupancy_bitmap.h"
+#include "marker_counters.h"
+#include "deadlock_detector.h"
+
+// Per-run knobs handed to every marker alongside the shared synchronization objects.
+struct MarkerSettings
+{
+    LockMode lockMode = LockMode::Global;
+    StripedLocks* stripes = nullptr;
+    WorkModel work;
+    RoundBarrier* barrier = nullptr;
+    OccupancyBitmap* occupancy = nullptr;
+    CounterBoard* counters = nullptr;
+    DeadlockDetector* deadlocks = nullptr;
+    int claimCells = 1;
+    bool timeWaits = false;
+    bool verbose = true;
+};
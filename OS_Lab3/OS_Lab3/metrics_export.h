@@ -0,0 +1,259 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "marker_counters.h"
+
+enum class MetricsFormat
+{
+    Json,
+    Prometheus
+};
+
+// Coordinator time for one round: waiting until every marker was blocked, getting the
+// victim to terminate and release its cells, and sending the others back to work.
+struct RoundTiming
+{
+    int victim = 0;
+    double waitMs = 0.0;
+    double terminateMs = 0.0;
+    double resumeMs = 0.0;
+};
+
+inline double msSince(std::chrono::steady_clock::time_point start)
+{
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+// What an export writes: the marker counters, read without locks, plus the rounds the
+// coordinator has finished so far.
+class RunMetrics
+{
+public:
+    explicit RunMetrics(const CounterBoard& counters)
+        : counters_(counters), start_(std::chrono::steady_clock::now()), finished_(false)
+    {
+    }
+
+    const CounterBoard& counters() const
+    {
+        return counters_;
+    }
+
+    void addRound(const RoundTiming& round)
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        rounds_.push_back(round);
+    }
+
+    std::vector<RoundTiming> rounds() const
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return rounds_;
+    }
+
+    void finish()
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        finished_ = true;
+    }
+
+    bool finished() const
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return finished_;
+    }
+
+    double elapsedMs() const
+    {
+        return msSince(start_);
+    }
+
+private:
+    const CounterBoard& counters_;
+    std::chrono::steady_clock::time_point start_;
+    mutable std::mutex mtx_;
+    std::vector<RoundTiming> rounds_;
+    bool finished_;
+};
+
+inline void writeMetricsJson(const RunMetrics& metrics, std::ostream& out)
+{
+    const CounterBoard& counters = metrics.counters();
+    out << "{\n  \"elapsed_ms\": " << metrics.elapsedMs() << ",\n  \"final\": " << (metrics.finished() ? "true" : "false")
+        << ",\n  \"markers\": [";
+    for (size_t i = 0; i < counters.size(); ++i)
+    {
+        const MarkerCounters& marker = counters.forMarker(static_cast<int>(i) + 1);
+        out << (i == 0 ? "\n" : ",\n") << "    {\"id\": " << i + 1 << ", \"marks\": " << marker.marked.load()
+            << ", \"blocks\": " << marker.blocked.load() << ", \"releases\": " << marker.released.load()
+            << ", \"lock_wait_ns\": " << marker.lockWaitNs.load() << ", \"cond_wait_ns\": " << marker.condWaitNs.load() << "}";
+    }
+    out << "\n  ],\n  \"rounds\": [";
+
+    std::vector<RoundTiming> rounds = metrics.rounds();
+    for (size_t i = 0; i < rounds.size(); ++i)
+    {
+        out << (i == 0 ? "\n" : ",\n") << "    {\"round\": " << i + 1 << ", \"victim\": " << rounds[i].victim
+            << ", \"wait_ms\": " << rounds[i].waitMs << ", \"terminate_ms\": " << rounds[i].terminateMs
+            << ", \"resume_ms\": " << rounds[i].resumeMs << "}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+// Node-exporter textfile format: per-marker counters labelled by marker id, rounds
+// folded into totals so the series count does not grow with the run.
+inline void writeMetricsPrometheus(const RunMetrics& metrics, std::ostream& out)
+{
+    struct MarkerMetric
+    {
+        const char* name;
+        const char* help;
+        std::atomic<long long> MarkerCounters::* counter;
+        double scale;
+    };
+    const MarkerMetric markerMetrics[] = {
+        { "lab3_marker_marks_total", "Cells marked by the marker.", &MarkerCounters::marked, 1.0 },
+        { "lab3_marker_blocks_total", "Times the marker could not mark a cell.", &MarkerCounters::blocked, 1.0 },
+        { "lab3_marker_releases_total", "Cells the marker released on termination.", &MarkerCounters::released, 1.0 },
+        { "lab3_marker_lock_wait_seconds_total", "Time the marker spent acquiring the shared mutex and stripe locks outside condition waits.", &MarkerCounters::lockWaitNs, 1e-9 },
+        { "lab3_marker_cond_wait_seconds_total", "Time the marker spent in condition waits, including re-taking the shared mutex when woken.", &MarkerCounters::condWaitNs, 1e-9 },
+    };
+
+    const CounterBoard& counters = metrics.counters();
+    for (const auto& metric : markerMetrics)
+    {
+        out << "# HELP " << metric.name << " " << metric.help << "\n# TYPE " << metric.name << " counter\n";
+        for (size_t i = 0; i < counters.size(); ++i)
+        {
+            const MarkerCounters& marker = counters.forMarker(static_cast<int>(i) + 1);
+            out << metric.name << "{marker=\"" << i + 1 << "\"} " << (marker.*metric.counter).load() * metric.scale << "\n";
+        }
+    }
+
+    RoundTiming total;
+    std::vector<RoundTiming> rounds = metrics.rounds();
+    for (const auto& round : rounds)
+    {
+        total.waitMs += round.waitMs;
+        total.terminateMs += round.terminateMs;
+        total.resumeMs += round.resumeMs;
+    }
+    out << "# HELP lab3_rounds_total Termination rounds completed.\n# TYPE lab3_rounds_total counter\n"
+        << "lab3_rounds_total " << rounds.size() << "\n";
+    out << "# HELP lab3_round_seconds_total Coordinator time per round phase.\n# TYPE lab3_round_seconds_total counter\n"
+        << "lab3_round_seconds_total{phase=\"wait\"} " << total.waitMs / 1000.0 << "\n"
+        << "lab3_round_seconds_total{phase=\"terminate\"} " << total.terminateMs / 1000.0 << "\n"
+        << "lab3_round_seconds_total{phase=\"resume\"} " << total.resumeMs / 1000.0 << "\n";
+    out << "# HELP lab3_run_seconds Time since the markers were created.\n# TYPE lab3_run_seconds gauge\n"
+        << "lab3_run_seconds " << metrics.elapsedMs() / 1000.0 << "\n";
+    out << "# HELP lab3_run_finished 1 once every marker has terminated.\n# TYPE lab3_run_finished gauge\n"
+        << "lab3_run_finished " << (metrics.finished() ? 1 : 0) << "\n";
+}
+
+// Writes next to `path` and renames over it, so a scraper never reads half a file.
+inline void exportMetrics(const RunMetrics& metrics, MetricsFormat format, const std::string& path)
+{
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::trunc);
+        if (!out)
+        {
+            throw std::invalid_argument("Cannot write metrics file '" + temporary + "'.");
+        }
+        if (format == MetricsFormat::Prometheus)
+        {
+            writeMetricsPrometheus(metrics, out);
+        }
+        else
+        {
+            writeMetricsJson(metrics, out);
+        }
+    }
+#ifdef _WIN32
+    std::remove(path.c_str());
+#endif
+    if (std::rename(temporary.c_str(), path.c_str()) != 0)
+    {
+        throw std::invalid_argument("Cannot replace metrics file '" + path + "'.");
+    }
+}
+
+// Exports once right away, so a bad path fails before the run, then every `interval`
+// (never when it is zero) until finish(), which writes the final snapshot.
+class MetricsExporter
+{
+public:
+    MetricsExporter(RunMetrics& metrics, MetricsFormat format, const std::string& path, std::chrono::milliseconds interval)
+        : metrics_(metrics), format_(format), path_(path), interval_(interval), stop_(false)
+    {
+        exportMetrics(metrics_, format_, path_);
+        if (interval_.count() > 0)
+        {
+            thread_ = std::thread([this] { exportLoop(); });
+        }
+    }
+
+    MetricsExporter(const MetricsExporter&) = delete;
+    MetricsExporter& operator=(const MetricsExporter&) = delete;
+
+    ~MetricsExporter()
+    {
+        stop();
+    }
+
+    void finish()
+    {
+        stop();
+        metrics_.finish();
+        exportMetrics(metrics_, format_, path_);
+    }
+
+private:
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            stop_ = true;
+        }
+        cv_.notify_one();
+        if (thread_.joinable())
+        {
+            thread_.join();
+        }
+    }
+
+    void exportLoop()
+    {
+        std::unique_lock<std::mutex> lock(mtx_);
+        while (!cv_.wait_for(lock, interval_, [this] { return stop_; }))
+        {
+            try
+            {
+                exportMetrics(metrics_, format_, path_);
+            }
+            catch (const std::exception& e)
+            {
+                std::cerr << "Metrics export: " << e.what() << std::endl;
+            }
+        }
+    }
+
+    RunMetrics& metrics_;
+    MetricsFormat format_;
+    std::string path_;
+    std::chrono::milliseconds interval_;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    bool stop_;
+    std::thread thread_;
+};
@@ -0,0 +1,78 @@
+#pragma once
+#include <cstddef>
+#include <iostream>
+#include <vector>
+#include "shared_array.h"
+
+enum class ArrayView
+{
+    Full,
+    Summary
+};
+
+struct OwnershipSummary
+{
+    std::vector<size_t> owned;
+    size_t freeCells = 0;
+    size_t total = 0;
+
+    double fillRatio() const
+    {
+        return total == 0 ? 0.0 : static_cast<double>(total - freeCells) / static_cast<double>(total);
+    }
+};
+
+// One pass over the cells into four interleaved sub-histograms, so consecutive
+// increments of the same bin do not wait on each other; the bins are summed at the end.
+// Bin 0 is the free count, bin numThreads + 1 collects anything out of range.
+template <typename Cell>
+OwnershipSummary summarizeOwnership(const BasicSharedArray<Cell>& array, int numThreads)
+{
+    const size_t bins = static_cast<size_t>(numThreads) + 2;
+    std::vector<size_t> counts(bins * 4, 0);
+    size_t* h0 = counts.data();
+    size_t* h1 = h0 + bins;
+    size_t* h2 = h1 + bins;
+    size_t* h3 = h2 + bins;
+    const unsigned outOfRange = static_cast<unsigned>(numThreads) + 1;
+
+    const Cell* cells = array.raw();
+    const size_t size = array.size();
+    size_t i = 0;
+    for (; i + 4 <= size; i += 4)
+    {
+        unsigned a = static_cast<unsigned>(cells[i]);
+        unsigned b = static_cast<unsigned>(cells[i + 1]);
+        unsigned c = static_cast<unsigned>(cells[i + 2]);
+        unsigned d = static_cast<unsigned>(cells[i + 3]);
+        ++h0[a < outOfRange ? a : outOfRange];
+        ++h1[b < outOfRange ? b : outOfRange];
+        ++h2[c < outOfRange ? c : outOfRange];
+        ++h3[d < outOfRange ? d : outOfRange];
+    }
+    for (; i < size; ++i)
+    {
+        unsigned a = static_cast<unsigned>(cells[i]);
+        ++h0[a < outOfRange ? a : outOfRange];
+    }
+
+    OwnershipSummary summary;
+    summary.total = size;
+    summary.freeCells = h0[0] + h1[0] + h2[0] + h3[0];
+    summary.owned.resize(static_cast<size_t>(numThreads));
+    for (size_t id = 1; id <= static_cast<size_t>(numThreads); ++id)
+    {
+        summary.owned[id - 1] = h0[id] + h1[id] + h2[id] + h3[id];
+    }
+    return summary;
+}
+
+inline void printSummary(const OwnershipSummary& summary, std::ostream& out = std::cout)
+{
+    out << "Free: " << summary.freeCells << " of " << summary.total << ", fill ratio " << summary.fillRatio() << "\n";
+    for (size_t i = 0; i < summary.owned.size(); ++i)
+    {
+        out << "Thread " << i + 1 << ": owns " << summary.owned[i] << "\n";
+    }
+    out.flush();
+}
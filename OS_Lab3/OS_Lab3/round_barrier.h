@@ -0,0 +1,114 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include "marker_control.h"
+#include "profiled_mutex.h"
+
+enum class RoundMode
+{
+    Handshake,
+    Barrier
+};
+
+// Round transitions in one step instead of a per-marker handshake: markers bump an
+// atomic blocked counter and the last one wakes the coordinator, which resumes
+// everybody by advancing the round epoch.
+// Each marker sleeps on its own MarkerControl::cvContinue, so a termination wakes the
+// victim alone and the others never leave their wait until the epoch moves.
+// Uses the run's shared mutex so markers in the global lock mode can block with it held.
+class RoundBarrier
+{
+public:
+    RoundBarrier(RunMutex& mtx, std::vector<MarkerControl>& controls)
+        : mtx_(mtx), controls_(controls), live_(static_cast<int>(controls.size())), blocked_(0), epoch_(0), wakeups_(0)
+    {
+    }
+
+    // Marker side, called with the shared mutex held. Returns true when the marker
+    // was picked for termination rather than resumed.
+    bool arriveAndWait(RunLock& lock, MarkerControl& control)
+    {
+        uint64_t epoch = epoch_;
+        if (blocked_.fetch_add(1) + 1 == live_.load())
+        {
+            cvAllBlocked_.notify_one();
+        }
+
+        while (epoch_ == epoch && !control.terminateSignal.load())
+        {
+            control.cvContinue.wait(lock);
+            ++wakeups_;
+        }
+        if (control.terminateSignal.load())
+        {
+            blocked_.fetch_sub(1);
+            return true;
+        }
+        return false;
+    }
+
+    // Marker side, called with the shared mutex held once its cleanup is done.
+    void depart()
+    {
+        live_.fetch_sub(1);
+        cvAllBlocked_.notify_one();
+    }
+
+    void waitAllBlocked()
+    {
+        if (blocked_.load() == live_.load())
+        {
+            return;
+        }
+
+        RunLock lock(mtx_);
+        cvAllBlocked_.wait(lock, [this] { return blocked_.load() == live_.load(); });
+    }
+
+    void terminate(MarkerControl& victim)
+    {
+        {
+            std::lock_guard<RunMutex> lock(mtx_);
+            victim.terminateSignal.store(true);
+        }
+        victim.cvContinue.notify_one();
+    }
+
+    // One epoch bump releases every survivor; the notifies go out after the mutex is
+    // dropped so the woken markers do not pile up on it behind the coordinator.
+    void resume()
+    {
+        {
+            std::lock_guard<RunMutex> lock(mtx_);
+            blocked_.store(0);
+            ++epoch_;
+        }
+        for (auto& control : controls_)
+        {
+            if (!control.terminateSignal.load())
+            {
+                control.cvContinue.notify_one();
+            }
+        }
+    }
+
+    // Times a waiting marker came back from its condition wait, spurious wakeups
+    // included: one per termination and one per survivor per resume when none is wasted.
+    long long wakeups() const
+    {
+        std::lock_guard<RunMutex> lock(mtx_);
+        return wakeups_;
+    }
+
+private:
+    RunMutex& mtx_;
+    std::vector<MarkerControl>& controls_;
+    RunCondition cvAllBlocked_;
+    std::atomic<int> live_;
+    std::atomic<int> blocked_;
+    uint64_t epoch_;
+    long long wakeups_;
+};
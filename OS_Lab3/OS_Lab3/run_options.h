@@ -0,0 +1,493 @@
+#pragma once
+#include <climits>
+#include <cstddef>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include "shared_array.h"
+#include "memory_placement.h"
+#include "cpu_topology.h"
+#include "work_model.h"
+#include "round_barrier.h"
+#include "ownership_summary.h"
+#include "deadlock_detector.h"
+#include "victim_policy.h"
+#include "metrics_export.h"
+
+enum class SchedulerKind
+{
+    Threads,
+    Pool,
+    Coroutine
+};
+
+struct RunOptions
+{
+    LockMode lockMode = LockMode::Global;
+    size_t stripeCount = 64;
+    WorkModel work;
+    RoundMode roundMode = RoundMode::Handshake;
+    ArrayView view = ArrayView::Full;
+    bool occupancyBitmap = false;
+    int arraySize = 0;
+    int numThreads = 0;
+    std::vector<int> terminationSchedule;
+    std::string mapFile;
+    NumaPolicy numa = NumaPolicy::None;
+    HugePages hugePages = HugePages::None;
+    PinPolicy pinPolicy = PinPolicy::None;
+    std::vector<int> pinCpus;
+    SchedulerKind scheduler = SchedulerKind::Threads;
+    unsigned workers = 0;
+    bool detectDeadlocks = false;
+    VictimCost victimCost = VictimCost::FewestMarks;
+    int claimCells = 1;
+    VictimPolicy victimPolicy = VictimPolicy::Prompt;
+    uint64_t victimSeed = 1;
+    std::string metricsFile;
+    MetricsFormat metricsFormat = MetricsFormat::Json;
+    std::chrono::milliseconds metricsInterval{ 0 };
+
+    // Size and thread count given up front mean nobody is at the prompt.
+    bool scripted() const
+    {
+        return arraySize > 0 || numThreads > 0;
+    }
+};
+
+inline size_t parsePositive(const std::string& flag, const std::string& value)
+{
+    size_t parsed = 0;
+    size_t consumed = 0;
+    try
+    {
+        parsed = std::stoul(value, &consumed);
+    }
+    catch (const std::exception&)
+    {
+        consumed = 0;
+    }
+
+    if (consumed != value.size() || parsed == 0 || value[0] == '-')
+    {
+        throw std::invalid_argument(flag + " expects a positive number, got '" + value + "'.");
+    }
+    return parsed;
+}
+
+inline int parsePositiveInt(const std::string& flag, const std::string& value)
+{
+    size_t parsed = parsePositive(flag, value);
+    if (parsed > static_cast<size_t>(INT_MAX))
+    {
+        throw std::invalid_argument(flag + " value '" + value + "' is too large.");
+    }
+    return static_cast<int>(parsed);
+}
+
+inline std::vector<int> parseIdList(const std::string& flag, const std::string& value)
+{
+    std::vector<int> ids;
+    std::stringstream stream(value);
+    std::string item;
+    while (std::getline(stream, item, ','))
+    {
+        ids.push_back(parsePositiveInt(flag, item));
+    }
+    return ids;
+}
+
+inline void applyOption(RunOptions& options, const std::string& flag, const std::string& value);
+
+// A scenario file holds one "name value" pair per line, using the flag names
+// without the leading dashes; '#' starts a comment.
+inline void loadScenario(RunOptions& options, const std::string& path)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        throw std::invalid_argument("Cannot open scenario file '" + path + "'.");
+    }
+
+    std::string line;
+    while (std::getline(file, line))
+    {
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        std::string name;
+        std::string value;
+        if (!(fields >> name))
+        {
+            continue;
+        }
+        if (!(fields >> value))
+        {
+            throw std::invalid_argument("Missing value for '" + name + "' in scenario file.");
+        }
+        applyOption(options, "--" + name, value);
+    }
+}
+
+inline void applyOption(RunOptions& options, const std::string& flag, const std::string& value)
+{
+    if (flag == "--lock")
+    {
+        if (value == "global")
+        {
+            options.lockMode = LockMode::Global;
+        }
+        else if (value == "striped")
+        {
+            options.lockMode = LockMode::Striped;
+        }
+        else if (value == "atomic")
+        {
+            options.lockMode = LockMode::Atomic;
+        }
+        else
+        {
+            throw std::invalid_argument("Unknown lock mode '" + value + "', expected global, striped or atomic.");
+        }
+    }
+    else if (flag == "--stripes")
+    {
+        options.stripeCount = parsePositive(flag, value);
+    }
+    else if (flag == "--work")
+    {
+        if (value == "none")
+        {
+            options.work.kind = WorkKind::None;
+        }
+        else if (value == "yield")
+        {
+            options.work.kind = WorkKind::Yield;
+        }
+        else if (value == "spin")
+        {
+            options.work.kind = WorkKind::Spin;
+        }
+        else if (value == "hash")
+        {
+            options.work.kind = WorkKind::Hash;
+        }
+        else if (value == "sleep")
+        {
+            options.work.kind = WorkKind::Sleep;
+        }
+        else
+        {
+            throw std::invalid_argument("Unknown work model '" + value + "', expected none, yield, spin, hash or sleep.");
+        }
+    }
+    else if (flag == "--work-us")
+    {
+        options.work.duration = std::chrono::microseconds(parsePositive(flag, value));
+    }
+    else if (flag == "--hash-bytes")
+    {
+        options.work.hashBytes = parsePositive(flag, value);
+    }
+    else if (flag == "--rounds")
+    {
+        if (value == "handshake")
+        {
+            options.roundMode = RoundMode::Handshake;
+        }
+        else if (value == "barrier")
+        {
+            options.roundMode = RoundMode::Barrier;
+        }
+        else
+        {
+            throw std::invalid_argument("Unknown round mode '" + value + "', expected handshake or barrier.");
+        }
+    }
+    else if (flag == "--view")
+    {
+        if (value == "full")
+        {
+            options.view = ArrayView::Full;
+        }
+        else if (value == "summary")
+        {
+            options.view = ArrayView::Summary;
+        }
+        else
+        {
+            throw std::invalid_argument("Unknown array view '" + value + "', expected full or summary.");
+        }
+    }
+    else if (flag == "--occupancy")
+    {
+        if (value == "none")
+        {
+            options.occupancyBitmap = false;
+        }
+        else if (value == "bitmap")
+        {
+            options.occupancyBitmap = true;
+        }
+        else
+        {
+            throw std::invalid_argument("Unknown occupancy index '" + value + "', expected none or bitmap.");
+        }
+    }
+    else if (flag == "--size")
+    {
+        options.arraySize = parsePositiveInt(flag, value);
+    }
+    else if (flag == "--threads")
+    {
+        options.numThreads = parsePositiveInt(flag, value);
+    }
+    else if (flag == "--terminate")
+    {
+        options.terminationSchedule = parseIdList(flag, value);
+    }
+    else if (flag == "--map-file")
+    {
+        options.mapFile = value;
+    }
+    else if (flag == "--numa")
+    {
+        if (value == "none")
+        {
+            options.numa = NumaPolicy::None;
+        }
+        else if (value == "interleave")
+        {
+            options.numa = NumaPolicy::Interleave;
+        }
+        else if (value == "blocks")
+        {
+            options.numa = NumaPolicy::Blocks;
+        }
+        else
+        {
+            throw std::invalid_argument("Unknown NUMA policy '" + value + "', expected none, interleave or blocks.");
+        }
+    }
+    else if (flag == "--huge-pages")
+    {
+        if (value == "none")
+        {
+            options.hugePages = HugePages::None;
+        }
+        else if (value == "thp")
+        {
+            options.hugePages = HugePages::Transparent;
+        }
+        else if (value == "explicit")
+        {
+            options.hugePages = HugePages::Explicit;
+        }
+        else
+        {
+            throw std::invalid_argument("Unknown huge page mode '" + value + "', expected none, thp or explicit.");
+        }
+    }
+    else if (flag == "--pin")
+    {
+        if (value == "none")
+        {
+            options.pinPolicy = PinPolicy::None;
+        }
+        else if (value == "compact")
+        {
+            options.pinPolicy = PinPolicy::Compact;
+        }
+        else if (value == "scatter")
+        {
+            options.pinPolicy = PinPolicy::Scatter;
+        }
+        else
+        {
+            options.pinPolicy = PinPolicy::List;
+            options.pinCpus = parseCpuList(value);
+        }
+    }
+    else if (flag == "--scheduler")
+    {
+        if (value == "threads")
+        {
+            options.scheduler = SchedulerKind::Threads;
+        }
+        else if (value == "pool")
+        {
+            options.scheduler = SchedulerKind::Pool;
+        }
+        else if (value == "coroutine")
+        {
+#if defined(__cpp_impl_coroutine)
+            options.scheduler = SchedulerKind::Coroutine;
+#else
+            throw std::invalid_argument("--scheduler coroutine needs the C++20 build (Lab3Coroutines).");
+#endif
+        }
+        else
+        {
+            throw std::invalid_argument("Unknown scheduler '" + value + "', expected threads, pool or coroutine.");
+        }
+    }
+    else if (flag == "--detect")
+    {
+        options.detectDeadlocks = true;
+        if (value == "fewest")
+        {
+            options.victimCost = VictimCost::FewestMarks;
+        }
+        else if (value == "youngest")
+        {
+            options.victimCost = VictimCost::Youngest;
+        }
+        else
+        {
+            throw std::invalid_argument("Unknown victim cost '" + value + "', expected fewest or youngest.");
+        }
+    }
+    else if (flag == "--victim")
+    {
+        std::string policy = value.substr(0, value.find(':'));
+        if (policy == "round-robin")
+        {
+            options.victimPolicy = VictimPolicy::RoundRobin;
+        }
+        else if (policy == "most")
+        {
+            options.victimPolicy = VictimPolicy::MostMarks;
+        }
+        else if (policy == "fewest")
+        {
+            options.victimPolicy = VictimPolicy::FewestMarks;
+        }
+        else if (policy == "random")
+        {
+            options.victimPolicy = VictimPolicy::Random;
+        }
+        else if (policy == "oldest")
+        {
+            options.victimPolicy = VictimPolicy::OldestBlocked;
+        }
+        else
+        {
+            throw std::invalid_argument("Unknown victim policy '" + value + "', expected round-robin, most, fewest, random[:SEED] or oldest.");
+        }
+
+        if (policy.size() != value.size())
+        {
+            if (options.victimPolicy != VictimPolicy::Random)
+            {
+                throw std::invalid_argument("Only --victim random takes a seed.");
+            }
+            options.victimSeed = static_cast<uint64_t>(parsePositive(flag, value.substr(policy.size() + 1)));
+        }
+    }
+    else if (flag == "--metrics-file")
+    {
+        options.metricsFile = value;
+    }
+    else if (flag == "--metrics-format")
+    {
+        if (value == "json")
+        {
+            options.metricsFormat = MetricsFormat::Json;
+        }
+        else if (value == "prometheus")
+        {
+            options.metricsFormat = MetricsFormat::Prometheus;
+        }
+        else
+        {
+            throw std::invalid_argument("Unknown metrics format '" + value + "', expected json or prometheus.");
+        }
+    }
+    else if (flag == "--metrics-interval-ms")
+    {
+        options.metricsInterval = std::chrono::milliseconds(parsePositive(flag, value));
+    }
+    else if (flag == "--claim-cells")
+    {
+        options.claimCells = parsePositiveInt(flag, value);
+    }
+    else if (flag == "--workers")
+    {
+        options.workers = static_cast<unsigned>(parsePositiveInt(flag, value));
+    }
+    else if (flag == "--scenario")
+    {
+        loadScenario(options, value);
+    }
+    else
+    {
+        throw std::invalid_argument("Unknown option " + flag + ".");
+    }
+}
+
+inline RunOptions parseOptions(int argc, char* argv[])
+{
+    RunOptions options;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string flag = argv[i];
+        if (i + 1 >= argc)
+        {
+            throw std::invalid_argument("Missing value for " + flag + ".");
+        }
+        applyOption(options, flag, argv[++i]);
+    }
+
+    if (options.scripted() && (options.arraySize == 0 || options.numThreads == 0))
+    {
+        throw std::invalid_argument("Scripted mode needs both --size and --threads.");
+    }
+
+    if (options.scheduler == SchedulerKind::Pool && (options.lockMode != LockMode::Atomic || options.roundMode != RoundMode::Handshake))
+    {
+        throw std::invalid_argument("--scheduler pool needs --lock atomic and the default rounds: a pooled marker may resume on another worker, so it cannot hold a mutex across its pauses.");
+    }
+
+    if (options.scheduler == SchedulerKind::Coroutine
+        && (options.lockMode != LockMode::Atomic || options.roundMode != RoundMode::Handshake || options.pinPolicy != PinPolicy::None))
+    {
+        throw std::invalid_argument("--scheduler coroutine needs --lock atomic, the default rounds and no --pin: every marker runs on the main thread and claims cells with CAS.");
+    }
+
+    if (options.detectDeadlocks
+        && (options.scheduler != SchedulerKind::Threads || options.roundMode != RoundMode::Handshake || !options.terminationSchedule.empty()))
+    {
+        throw std::invalid_argument("--detect picks its own victims and works with the thread scheduler and the default rounds only; it cannot be combined with --terminate.");
+    }
+
+    if (options.victimPolicy != VictimPolicy::Prompt && (options.detectDeadlocks || !options.terminationSchedule.empty()))
+    {
+        throw std::invalid_argument("--victim chooses every victim itself and cannot be combined with --detect or --terminate.");
+    }
+
+    if (options.claimCells > 1 && options.scheduler != SchedulerKind::Threads)
+    {
+        throw std::invalid_argument("--claim-cells works with the thread scheduler only.");
+    }
+
+    if (options.scripted() && options.claimCells > options.arraySize)
+    {
+        throw std::invalid_argument("--claim-cells cannot exceed the array size.");
+    }
+
+    if (!options.mapFile.empty() && (options.numa != NumaPolicy::None || options.hugePages != HugePages::None))
+    {
+        throw std::invalid_argument("--numa and --huge-pages place the in-memory array and cannot be combined with --map-file.");
+    }
+
+    for (int id : options.terminationSchedule)
+    {
+        if (options.numThreads != 0 && id > options.numThreads)
+        {
+            throw std::invalid_argument("Termination schedule names thread " + std::to_string(id) + " but only "
+                + std::to_string(options.numThreads) + " are started.");
+        }
+    }
+    return options;
+}
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iostream>
 #include <vector>
 #include <thread>
@@ -5,16 +6,33 @@
 #include <condition_variable>
 #include <atomic>
 #include <chrono>
+#include <cstdint>
+#include <memory>
 #include <stdexcept>
+#include "shared_array.h"
+#include "striped_locks.h"
+#include "marker_settings.h"
+#include "marker_control.h"
+#include "ownership_journal.h"
+#include "marker_rng.h"
+#include "array_output.h"
+#include "ownership_summary.h"
+#include "run_options.h"
+#include "marker_task.h"
+#include "task_pool.h"
+#include "marker_coroutine.h"
+#include "metrics_export.h"
+#include "profiled_mutex.h"
 
+template <typename Cell>
 class MarkerThread
 {
 public:
-    MarkerThread(int id, std::vector<int>& array, std::mutex& mtx, std::condition_variable& cvStart,
-        std::vector<std::condition_variable>& cvContinue, std::vector<bool>& continueSignal,
-        std::vector<bool>& terminateSignal, std::atomic<bool>& startSignal)
-        : id_(id), array_(array), mtx_(mtx), cvStart_(cvStart), cvContinue_(cvContinue),
-        continueSignal_(continueSignal), terminateSignal_(terminateSignal), startSignal_(startSignal)
+    MarkerThread(int id, BasicSharedArray<Cell>& array, RunMutex& mtx, RunCondition& cvStart,
+        MarkerControl& control, std::atomic<bool>& startSignal, const MarkerSettings& settings = MarkerSettings())
+        : id_(id), array_(array), mtx_(mtx), cvStart_(cvStart), control_(control), startSignal_(startSignal),
+        settings_(settings), counters_(settings.counters != nullptr ? &settings.counters->forMarker(id) : nullptr),
+        indices_(static_cast<uint64_t>(id), static_cast<uint32_t>(array.size()))
     {
     }
 
@@ -22,46 +40,95 @@ public:
     {
         try
         {
-            std::unique_lock<std::mutex> lock(mtx_);
+            RunLock lock(mtx_, std::defer_lock);
+            acquire(lock);
             cvStart_.wait(lock, [this] { return startSignal_.load(); });
 
-            srand(id_);
+            // Only the global mode keeps the shared mutex while marking; the other modes
+            // take it for the block/continue handshake alone.
+            bool holdLock = settings_.lockMode == LockMode::Global;
+            if (!holdLock)
+            {
+                lock.unlock();
+            }
 
             int markedCount = 0;
-            while (!terminateSignal_[id_ - 1])
+            while (!control_.terminateSignal.load(std::memory_order_acquire))
             {
-                int randomIndex = rand() % array_.size();
-                if (array_[randomIndex] == 0)
+                int randomIndex = static_cast<int>(indices_.next());
+                if (settings_.claimCells > 1 ? tryMarkMany(randomIndex) : tryMark(randomIndex))
                 {
-                    std::this_thread::sleep_for(std::chrono::milliseconds(5));
-                    array_[randomIndex] = id_;
-                    std::this_thread::sleep_for(std::chrono::milliseconds(5));
-                    ++markedCount;
+                    markedCount += settings_.claimCells;
+                    if (counters_ != nullptr)
+                    {
+                        MarkerCounters::bump(counters_->marked, settings_.claimCells);
+                    }
+                    continue;
                 }
-                else
+
+                if (counters_ != nullptr)
+                {
+                    counters_->noteBlocked();
+                }
+                if (!holdLock)
+                {
+                    acquire(lock);
+                }
+
+                if (settings_.verbose)
                 {
                     std::cout << "Thread " << id_ << ": marked " << markedCount << " elements, cannot mark index " << randomIndex << std::endl;
-                    continueSignal_[id_ - 1] = false;
-                    cvContinue_[id_ - 1].notify_one();
+                }
+                if (settings_.barrier != nullptr)
+                {
+                    WaitTimer timer(waitCounter(&MarkerCounters::condWaitNs));
+                    if (settings_.barrier->arriveAndWait(lock, control_))
+                    {
+                        break;
+                    }
+                }
+                else
+                {
+                    if (settings_.deadlocks != nullptr && !settings_.deadlocks->block(id_, array_.load(randomIndex)))
+                    {
+                        if (!holdLock)
+                        {
+                            lock.unlock();
+                        }
+                        continue;
+                    }
+                    control_.continueSignal.store(false);
+                    control_.cvContinue.notify_one();
 
-                    cvContinue_[id_ - 1].wait(lock, [this] { return continueSignal_[id_ - 1] || terminateSignal_[id_ - 1]; });
-                    if (terminateSignal_[id_ - 1])
+                    {
+                        WaitTimer timer(waitCounter(&MarkerCounters::condWaitNs));
+                        control_.cvContinue.wait(lock, [this] { return control_.continueSignal.load() || control_.terminateSignal.load(); });
+                    }
+                    if (control_.terminateSignal.load())
                     {
                         break;
                     }
                 }
-            }
 
-            for (size_t i = 0; i < array_.size(); ++i)
-            {
-                if (array_[i] == id_)
+                if (!holdLock)
                 {
-                    array_[i] = 0;
+                    lock.unlock();
                 }
             }
 
-            terminateSignal_[id_ - 1] = true;
-            cvContinue_[id_ - 1].notify_one();
+            if (!lock.owns_lock())
+            {
+                acquire(lock);
+            }
+
+            clearMarks();
+
+            control_.terminateSignal.store(true);
+            if (settings_.barrier != nullptr)
+            {
+                settings_.barrier->depart();
+            }
+            control_.cvContinue.notify_one();
         }
         catch (const std::exception& e)
         {
@@ -70,127 +137,977 @@ public:
     }
 
 private:
+    // The wait counter to charge, or none when waits are not being timed.
+    std::atomic<long long>* waitCounter(std::atomic<long long> MarkerCounters::* counter)
+    {
+        return settings_.timeWaits && counters_ != nullptr ? &(counters_->*counter) : nullptr;
+    }
+
+    template <typename Lockable>
+    void acquire(Lockable& lockable)
+    {
+        WaitTimer timer(waitCounter(&MarkerCounters::lockWaitNs));
+        lockable.lock();
+    }
+
+    // The bitmap answers from one bit per cell only in the global mode, where its bits
+    // change under the same mutex as the cells. Elsewhere a bit may lag its cell, so
+    // the cell itself is read.
+    bool cellFree(int index) const
+    {
+        if (settings_.occupancy != nullptr && settings_.lockMode == LockMode::Global)
+        {
+            return !settings_.occupancy->test(index);
+        }
+        return array_.load(index) == 0;
+    }
+
+    bool markCell(int index)
+    {
+        if (!cellFree(index))
+        {
+            return false;
+        }
+
+        settings_.work.perform();
+        array_.store(index, id_);
+        if (settings_.occupancy != nullptr)
+        {
+            settings_.occupancy->set(index);
+        }
+        settings_.work.perform();
+        return true;
+    }
+
+    // A failed CAS means another marker got the cell first, which is the same
+    // "cannot mark index" event as finding it already taken.
+    bool claimCell(int index)
+    {
+        if (!cellFree(index))
+        {
+            return false;
+        }
+
+        settings_.work.perform();
+        if (!array_.claim(index, id_))
+        {
+            return false;
+        }
+        if (settings_.occupancy != nullptr)
+        {
+            settings_.occupancy->set(index);
+        }
+        settings_.work.perform();
+        return true;
+    }
+
+    bool tryMark(int index)
+    {
+        bool marked;
+        switch (settings_.lockMode)
+        {
+        case LockMode::Striped:
+        {
+            std::mutex& stripe = settings_.stripes->forIndex(index);
+            acquire(stripe);
+            std::lock_guard<std::mutex> stripeLock(stripe, std::adopt_lock);
+            marked = markCell(index);
+            break;
+        }
+        case LockMode::Atomic:
+            marked = claimCell(index);
+            break;
+        default:
+            marked = markCell(index);
+            break;
+        }
+
+        if (marked)
+        {
+            journal_.record(index);
+        }
+        return marked;
+    }
+
+    // Marks cells whose owners were all checked under the caller's locks.
+    bool markAll(const std::vector<size_t>& cells, int& index)
+    {
+        for (size_t cell : cells)
+        {
+            if (!cellFree(static_cast<int>(cell)))
+            {
+                index = static_cast<int>(cell);
+                return false;
+            }
+        }
+
+        settings_.work.perform();
+        for (size_t cell : cells)
+        {
+            array_.store(cell, id_);
+            if (settings_.occupancy != nullptr)
+            {
+                settings_.occupancy->set(cell);
+            }
+        }
+        settings_.work.perform();
+        return true;
+    }
+
+    // Stripes are always taken in ascending order, so two markers that want
+    // overlapping stripes cannot hold one each and wait for the other.
+    bool markStriped(const std::vector<size_t>& cells, int& index)
+    {
+        stripeBuffer_.clear();
+        for (size_t cell : cells)
+        {
+            stripeBuffer_.push_back(cell / settings_.stripes->stripeSize());
+        }
+        std::sort(stripeBuffer_.begin(), stripeBuffer_.end());
+        stripeBuffer_.erase(std::unique(stripeBuffer_.begin(), stripeBuffer_.end()), stripeBuffer_.end());
+
+        for (size_t stripe : stripeBuffer_)
+        {
+            acquire(settings_.stripes->stripe(stripe));
+        }
+        bool marked = markAll(cells, index);
+        for (auto stripe = stripeBuffer_.rbegin(); stripe != stripeBuffer_.rend(); ++stripe)
+        {
+            settings_.stripes->stripe(*stripe).unlock();
+        }
+        return marked;
+    }
+
+    // CAS one cell after another and give back the ones already won when a later
+    // CAS loses, so nothing stays claimed while the marker is blocked.
+    bool claimAll(const std::vector<size_t>& cells, int& index)
+    {
+        for (size_t cell : cells)
+        {
+            if (!cellFree(static_cast<int>(cell)))
+            {
+                index = static_cast<int>(cell);
+                return false;
+            }
+        }
+
+        settings_.work.perform();
+        for (size_t i = 0; i < cells.size(); ++i)
+        {
+            if (!array_.claim(cells[i], id_))
+            {
+                for (size_t j = 0; j < i; ++j)
+                {
+                    array_.store(cells[j], 0);
+                }
+                index = static_cast<int>(cells[i]);
+                return false;
+            }
+        }
+        for (size_t cell : cells)
+        {
+            if (settings_.occupancy != nullptr)
+            {
+                settings_.occupancy->set(cell);
+            }
+        }
+        settings_.work.perform();
+        return true;
+    }
+
+    // All-or-nothing claim of settings_.claimCells distinct cells, `index` first. On
+    // failure `index` is the cell that was taken and none of them is held.
+    bool tryMarkMany(int& index)
+    {
+        claimBuffer_.assign(1, static_cast<size_t>(index));
+        while (claimBuffer_.size() < static_cast<size_t>(settings_.claimCells))
+        {
+            size_t next = indices_.next();
+            if (std::find(claimBuffer_.begin(), claimBuffer_.end(), next) == claimBuffer_.end())
+            {
+                claimBuffer_.push_back(next);
+            }
+        }
+
+        bool marked;
+        switch (settings_.lockMode)
+        {
+        case LockMode::Striped:
+            marked = markStriped(claimBuffer_, index);
+            break;
+        case LockMode::Atomic:
+            marked = claimAll(claimBuffer_, index);
+            break;
+        default:
+            marked = markAll(claimBuffer_, index);
+            break;
+        }
+
+        if (marked)
+        {
+            for (size_t cell : claimBuffer_)
+            {
+                journal_.record(cell);
+            }
+        }
+        return marked;
+    }
+
+    // Walks only the cells this marker claimed instead of scanning the whole array.
+    // Only the owner ever resets a non-zero cell, so a plain store is enough even in
+    // the lock-free mode.
+    void clearMarks()
+    {
+        journal_.forEach([this](size_t index)
+        {
+            if (settings_.lockMode == LockMode::Striped)
+            {
+                std::mutex& stripe = settings_.stripes->forIndex(index);
+                acquire(stripe);
+                std::lock_guard<std::mutex> stripeLock(stripe, std::adopt_lock);
+                releaseCell(index);
+            }
+            else
+            {
+                releaseCell(index);
+            }
+        });
+
+        if (counters_ != nullptr)
+        {
+            MarkerCounters::bump(counters_->released, static_cast<long long>(journal_.size()));
+        }
+        if (settings_.verbose)
+        {
+            std::cout << "Thread " << id_ << ": released " << journal_.size() << " elements, journal " << journal_.memoryBytes()
+                << " bytes vs " << array_.size() * sizeof(Cell) << " bytes for a full scan" << std::endl;
+        }
+        journal_.clear();
+    }
+
+    void releaseCell(size_t index)
+    {
+        array_.store(index, 0);
+        if (settings_.occupancy != nullptr)
+        {
+            settings_.occupancy->reset(index);
+        }
+    }
+
     int id_;
-    std::vector<int>& array_;
-    std::mutex& mtx_;
-    std::condition_variable& cvStart_;
-    std::vector<std::condition_variable>& cvContinue_;
-    std::vector<bool>& continueSignal_;
-    std::vector<bool>& terminateSignal_;
+    BasicSharedArray<Cell>& array_;
+    RunMutex& mtx_;
+    RunCondition& cvStart_;
+    MarkerControl& control_;
     std::atomic<bool>& startSignal_;
+    MarkerSettings settings_;
+    MarkerCounters* counters_;
+    OwnershipJournal journal_;
+    IndexBatch indices_;
+    std::vector<size_t> claimBuffer_;
+    std::vector<size_t> stripeBuffer_;
 };
 
-void printArray(const std::vector<int>& array)
+// With --occupancy bitmap the summary also reports what the bitmap says, read a word
+// at a time, next to the per-cell count.
+template <typename Cell>
+void showArray(const BasicSharedArray<Cell>& array, ArrayView view, const CounterBoard& counters, const OccupancyBitmap* occupancy)
 {
-    for (int num : array) {
-        std::cout << num << " ";
+    if (view == ArrayView::Summary)
+    {
+        printSummary(summarizeOwnership(array, static_cast<int>(counters.size())));
+        CounterTotals totals = counters.totals();
+        std::cout << "Marked: " << totals.marked << ", released: " << totals.released
+            << ", blocked: " << totals.blocked << std::endl;
+        if (occupancy != nullptr)
+        {
+            std::cout << "Bitmap: " << occupancy->freeCells() << " free, ";
+            if (occupancy->saturated())
+            {
+                std::cout << "saturated" << std::endl;
+            }
+            else
+            {
+                std::cout << "first free cell " << occupancy->nextFree(0) << std::endl;
+            }
+        }
+    }
+    else
+    {
+        printArray(array);
     }
-    std::cout << std::endl;
 }
 
-int main()
+// Follows the scripted schedule, skipping threads that are already gone; once the
+// schedule runs out the lowest-numbered live thread is picked.
+int nextScheduledVictim(const std::vector<int>& schedule, size_t& position, const std::vector<MarkerControl>& controls)
 {
-    try
+    while (position < schedule.size())
     {
-        int arraySize;
-        std::cout << "Enter the size of the array: ";
-        std::cin >> arraySize;
+        int id = schedule[position++];
+        if (!controls[id - 1].terminateSignal.load())
+        {
+            return id;
+        }
+    }
 
-        if (arraySize <= 0)
+    for (size_t i = 0; i < controls.size(); ++i)
+    {
+        if (!controls[i].terminateSignal.load())
         {
-            throw std::invalid_argument("Array size must be positive.");
+            return static_cast<int>(i) + 1;
         }
+    }
+    return 0;
+}
 
-        std::vector<int> array(arraySize, 0);
+void printRunSummary(double wallMs, int rounds, const CounterBoard& counters)
+{
+    std::cout << "wall_ms=" << wallMs << std::endl;
+    std::cout << "rounds=" << rounds << std::endl;
+    std::cout << "marks=";
+    for (size_t i = 0; i < counters.size(); ++i)
+    {
+        std::cout << (i == 0 ? "" : ",") << counters.forMarker(static_cast<int>(i) + 1).marked.load();
+    }
+    std::cout << std::endl;
+    std::cout << "blocked=" << counters.totals().blocked << std::endl;
+}
 
-        int numThreads;
-        std::cout << "Enter the number of marker threads: ";
-        std::cin >> numThreads;
+void printDrainSummary(VictimPolicy policy, double wallMs, int rounds)
+{
+    std::cout << "victim_policy=" << victimPolicyName(policy) << " drain_ms=" << wallMs
+        << " rounds_per_sec=" << (wallMs > 0.0 ? rounds * 1000.0 / wallMs : 0.0) << std::endl;
+}
 
-        if (numThreads <= 0)
+// Every successful step marked claimCells cells and every failed one was an abort.
+void printClaimSummary(double wallMs, int claimCells, const CounterTotals& totals)
+{
+    long long claims = totals.marked / claimCells;
+    long long attempts = claims + totals.blocked;
+    std::cout << "claim_cells=" << claimCells << " claims=" << claims << " aborts=" << totals.blocked
+        << " abort_rate=" << (attempts > 0 ? static_cast<double>(totals.blocked) / attempts : 0.0)
+        << " claims_per_sec=" << (wallMs > 0.0 ? claims * 1000.0 / wallMs : 0.0) << std::endl;
+}
+
+void printMappingSummary(const MappedFile& mapping, const PagingSample& paging, double flushMs)
+{
+    std::cout << "map_file=" << mapping.path() << std::endl;
+    std::cout << "map_bytes=" << mapping.bytes() << std::endl;
+    std::cout << "page_faults_minor=" << paging.minorFaults << std::endl;
+    std::cout << "page_faults_major=" << paging.majorFaults << std::endl;
+    std::cout << "writeback_bytes=" << paging.writtenBytes << std::endl;
+    std::cout << "msync_ms=" << flushMs << std::endl;
+}
+
+void printPlacement(const PlacedBuffer& placement, std::ostream& out)
+{
+    out << "placement=" << numaPolicyName(placement.numa()) << " nodes=" << placement.nodes()
+        << " numa_applied=" << (placement.numaApplied() ? 1 : 0) << std::endl;
+    out << "huge_pages=" << hugePagesName(placement.hugePages()) << " placed_bytes=" << placement.bytes()
+        << " anon_huge_kb=" << PlacedBuffer::anonHugePagesKb() << std::endl;
+}
+
+// Pins marker i to entry i of the policy's CPU order, wrapping around when there are
+// more markers than CPUs. Returns the CPU of every marker, -1 where the OS refused.
+std::vector<int> pinMarkers(std::vector<std::thread>& threads, const RunOptions& options)
+{
+    std::vector<int> order = options.pinPolicy == PinPolicy::List ? options.pinCpus : pinOrder(readCpuTopology(), options.pinPolicy);
+    std::vector<int> cpus;
+    for (size_t i = 0; i < threads.size(); ++i)
+    {
+        int cpu = order[i % order.size()];
+        cpus.push_back(pinThread(threads[i], cpu) ? cpu : -1);
+    }
+    return cpus;
+}
+
+void printPinning(PinPolicy policy, const std::vector<int>& cpus, std::ostream& out)
+{
+    out << "pinning=" << pinPolicyName(policy) << " cpus=";
+    for (size_t i = 0; i < cpus.size(); ++i)
+    {
+        out << (i == 0 ? "" : ",");
+        if (cpus[i] < 0)
         {
-            throw std::invalid_argument("Number of threads must be positive.");
+            out << "-";
         }
+        else
+        {
+            out << cpus[i];
+        }
+    }
+    out << std::endl;
+}
 
-        std::vector<std::thread> threads;
-        std::mutex mtx;
-        std::condition_variable cvStart;
-        std::vector<std::condition_variable> cvContinue(numThreads);
-        std::vector<bool> continueSignal(numThreads, true);
-        std::vector<bool> terminateSignal(numThreads, false);
-        std::atomic<bool> startSignal(false);
+struct DeadlockStats
+{
+    int rounds = 0;
+    double resolveUsMax = 0.0;
+    double resolveUsTotal = 0.0;
+};
 
-        for (int i = 0; i < numThreads; ++i)
+// Terminates one marker per cycle as the detector reports them, then lets the markers
+// that waited on it go on; markers outside the cycle never stop. Each marker leaves
+// through some cycle, the last one through a wait on its own cell.
+DeadlockStats breakDeadlocks(DeadlockDetector& detector, RunMutex& mtx, std::vector<MarkerControl>& controls,
+    std::vector<std::thread>& threads, RunMetrics& metrics, VictimCost cost, bool verbose)
+{
+    DeadlockStats stats;
+    for (size_t live = threads.size(); live > 0; --live)
+    {
+        auto roundStart = std::chrono::steady_clock::now();
+        RunLock lock(mtx);
+        DeadlockCycle cycle = detector.waitForCycle(lock);
+        RoundTiming timing;
+        timing.waitMs = msSince(roundStart);
+        int victim = chooseVictim(cycle, cost, metrics.counters());
+        timing.victim = victim;
+        if (verbose)
         {
-            threads.emplace_back(MarkerThread(i + 1, array, mtx, cvStart, cvContinue, continueSignal, terminateSignal, startSignal));
+            std::cout << "Deadlock:";
+            for (int member : cycle.members)
+            {
+                std::cout << " " << member << " ->";
+            }
+            std::cout << " " << cycle.members.front() << ", terminating thread " << victim << std::endl;
         }
 
+        auto terminateStart = std::chrono::steady_clock::now();
+        controls[victim - 1].terminateSignal.store(true);
+        controls[victim - 1].cvContinue.notify_one();
+        lock.unlock();
+        threads[victim - 1].join();
+        timing.terminateMs = msSince(terminateStart);
+
+        auto resumeStart = std::chrono::steady_clock::now();
+        lock.lock();
+        for (int waiter : detector.remove(victim))
         {
-            std::lock_guard<std::mutex> lock(mtx);
-            startSignal.store(true);
-            cvStart.notify_all();
+            controls[waiter - 1].continueSignal.store(true);
+            controls[waiter - 1].cvContinue.notify_one();
         }
+        timing.resumeMs = msSince(resumeStart);
+        metrics.addRound(timing);
+        std::chrono::duration<double, std::micro> resolve = std::chrono::steady_clock::now() - cycle.detectedAt;
+        stats.resolveUsMax = resolve.count() > stats.resolveUsMax ? resolve.count() : stats.resolveUsMax;
+        stats.resolveUsTotal += resolve.count();
+        ++stats.rounds;
+    }
+    return stats;
+}
+
+#if defined(__cpp_impl_coroutine)
+// The same rounds with every marker a coroutine on this thread. The coordinator resumes
+// a parked marker itself, so a round costs function calls instead of futex wakeups.
+template <typename Cell>
+void runCoroutineMarkers(const RunOptions& options, int arraySize, int numThreads, bool scripted)
+{
+    PagingSample pagingAtStart = PagingSample::now();
+    BasicSharedArray<Cell> array(arraySize, options.mapFile, options.numa, options.hugePages);
+    if (array.placement() != nullptr && !scripted)
+    {
+        printPlacement(*array.placement(), std::cout);
+    }
+
+    // Opt-in: every mark and release pays an atomic on a word shared with 63 other cells.
+    std::unique_ptr<OccupancyBitmap> occupancy;
+    if (options.occupancyBitmap)
+    {
+        occupancy.reset(new OccupancyBitmap(array.size()));
+    }
+
+    CounterBoard counters(numThreads);
+    MarkerSettings settings;
+    settings.lockMode = options.lockMode;
+    settings.work = options.work;
+    settings.occupancy = occupancy.get();
+    settings.counters = &counters;
+    settings.verbose = !scripted;
+
+    RunMetrics metrics(counters);
+    std::unique_ptr<MetricsExporter> exporter;
+    if (!options.metricsFile.empty())
+    {
+        exporter.reset(new MetricsExporter(metrics, options.metricsFormat, options.metricsFile, options.metricsInterval));
+    }
+
+    // The controls only carry the terminate flags nextScheduledVictim looks at.
+    CoroutineLoop loop;
+    StartGate start(loop);
+    std::vector<MarkerControl> controls(numThreads);
+    std::vector<RoundSlot> slots(numThreads);
+    std::vector<MarkerCoroutine> markers;
+    markers.reserve(numThreads);
+    for (int i = 0; i < numThreads; ++i)
+    {
+        markers.push_back(runMarkerCoroutine(i + 1, array, loop, start, slots[i], settings));
+    }
 
-        bool allTerminated = false;
-        while (!allTerminated)
+    auto startTime = std::chrono::steady_clock::now();
+    start.open();
+
+    int rounds = 0;
+    size_t schedulePosition = 0;
+    VictimPicker picker(options.victimPolicy, options.victimSeed);
+    int live = numThreads;
+    while (live > 0)
+    {
+        auto roundStart = std::chrono::steady_clock::now();
+        loop.runUntilIdle();
+        RoundTiming timing;
+        timing.waitMs = msSince(roundStart);
+
+        int threadToTerminate;
+        if (options.victimPolicy != VictimPolicy::Prompt)
         {
-            for (int i = 0; i < numThreads; ++i)
+            threadToTerminate = picker.next(controls, counters);
+            if (!scripted)
             {
-                std::unique_lock<std::mutex> lock(mtx);
-                cvContinue[i].wait(lock, [&continueSignal, i] { return !continueSignal[i]; });
+                std::cout << "Terminating thread " << threadToTerminate << " (" << victimPolicyName(options.victimPolicy) << ")" << std::endl;
             }
+        }
+        else if (scripted)
+        {
+            threadToTerminate = nextScheduledVictim(options.terminationSchedule, schedulePosition, controls);
+        }
+        else
+        {
+            showArray(array, options.view, counters, occupancy.get());
 
-            printArray(array);
-
-            int threadToTerminate;
             std::cout << "Enter the number of the thread to terminate: ";
             std::cin >> threadToTerminate;
+        }
+
+        if (threadToTerminate < 1 || threadToTerminate > numThreads)
+        {
+            std::cerr << "Invalid thread number." << std::endl;
+            continue;
+        }
 
-            if (threadToTerminate < 1 || threadToTerminate > numThreads)
+        RoundSlot& victim = slots[threadToTerminate - 1];
+        if (controls[threadToTerminate - 1].terminateSignal.load())
+        {
+            std::cerr << "Thread " << threadToTerminate << " has already terminated." << std::endl;
+            continue;
+        }
+
+        timing.victim = threadToTerminate;
+        auto terminateStart = std::chrono::steady_clock::now();
+        controls[threadToTerminate - 1].terminateSignal.store(true);
+        victim.terminate = true;
+        loop.resume(victim.waiting);
+        timing.terminateMs = msSince(terminateStart);
+        --live;
+        ++rounds;
+
+        if (!scripted)
+        {
+            showArray(array, options.view, counters, occupancy.get());
+        }
+
+        auto resumeStart = std::chrono::steady_clock::now();
+        for (auto& slot : slots)
+        {
+            if (slot.parked())
             {
-                std::cerr << "Invalid thread number." << std::endl;
-                continue;
+                loop.resume(slot.waiting);
             }
+        }
+        timing.resumeMs = msSince(resumeStart);
+        metrics.addRound(timing);
+    }
+
+    std::chrono::duration<double, std::milli> wall = std::chrono::steady_clock::now() - startTime;
+    double flushMs = array.mapping() != nullptr ? array.mapping()->flush() : 0.0;
+    if (exporter)
+    {
+        exporter->finish();
+    }
+    if (scripted)
+    {
+        printRunSummary(wall.count(), rounds, counters);
+        if (options.victimPolicy != VictimPolicy::Prompt)
+        {
+            printDrainSummary(options.victimPolicy, wall.count(), rounds);
+        }
+        if (array.placement() != nullptr)
+        {
+            printPlacement(*array.placement(), std::cout);
+        }
+        std::cout << "scheduler=coroutine switches=" << loop.switches() << std::endl;
+        if (array.mapping() != nullptr)
+        {
+            printMappingSummary(*array.mapping(), PagingSample::now().since(pagingAtStart), flushMs);
+        }
+    }
+    else if (options.victimPolicy != VictimPolicy::Prompt)
+    {
+        printDrainSummary(options.victimPolicy, wall.count(), rounds);
+    }
+}
+#endif
+
+// Everything after the prompts, instantiated for the narrowest cell that holds every
+// marker id.
+template <typename Cell>
+void runMarkers(const RunOptions& options, int arraySize, int numThreads, bool scripted)
+{
+#if defined(__cpp_impl_coroutine)
+    if (options.scheduler == SchedulerKind::Coroutine)
+    {
+        runCoroutineMarkers<Cell>(options, arraySize, numThreads, scripted);
+        return;
+    }
+#endif
+
+    PagingSample pagingAtStart = PagingSample::now();
+    BasicSharedArray<Cell> array(arraySize, options.mapFile, options.numa, options.hugePages);
+    if (array.placement() != nullptr && !scripted)
+    {
+        printPlacement(*array.placement(), std::cout);
+    }
+
+    std::vector<std::thread> threads;
+    RunMutex mtx;
+    RunCondition cvStart;
+    std::vector<MarkerControl> controls(numThreads);
+    std::atomic<bool> startSignal(false);
+    std::unique_ptr<StripedLocks> stripes;
+    if (options.lockMode == LockMode::Striped)
+    {
+        stripes.reset(new StripedLocks(array.size(), options.stripeCount));
+    }
+
+    std::unique_ptr<RoundBarrier> barrier;
+    if (options.roundMode == RoundMode::Barrier)
+    {
+        barrier.reset(new RoundBarrier(mtx, controls));
+    }
+
+    std::unique_ptr<DeadlockDetector> detector;
+    if (options.detectDeadlocks)
+    {
+        detector.reset(new DeadlockDetector(numThreads));
+    }
 
-            if (terminateSignal[threadToTerminate - 1])
+    // Opt-in: every mark and release pays an atomic on a word shared with 63 other cells.
+    std::unique_ptr<OccupancyBitmap> occupancy;
+    if (options.occupancyBitmap)
+    {
+        occupancy.reset(new OccupancyBitmap(array.size()));
+    }
+
+    CounterBoard counters(numThreads);
+    MarkerSettings settings;
+    settings.lockMode = options.lockMode;
+    settings.stripes = stripes.get();
+    settings.work = options.work;
+    settings.barrier = barrier.get();
+    settings.occupancy = occupancy.get();
+    settings.counters = &counters;
+    settings.deadlocks = detector.get();
+    settings.claimCells = options.claimCells;
+    settings.timeWaits = !options.metricsFile.empty();
+    settings.verbose = !scripted;
+
+    RunMetrics metrics(counters);
+    std::unique_ptr<MetricsExporter> exporter;
+    if (!options.metricsFile.empty())
+    {
+        exporter.reset(new MetricsExporter(metrics, options.metricsFormat, options.metricsFile, options.metricsInterval));
+    }
+
+    // With the pool scheduler markers are tasks and the pool's workers are what gets pinned.
+    bool pooled = options.scheduler == SchedulerKind::Pool;
+    MarkerRoster roster(numThreads);
+    std::vector<std::unique_ptr<MarkerTask<Cell>>> tasks;
+    std::unique_ptr<TaskPool> pool;
+    if (pooled)
+    {
+        for (int i = 0; i < numThreads; ++i)
+        {
+            tasks.emplace_back(new MarkerTask<Cell>(i + 1, array, controls[i], roster, settings));
+        }
+        pool.reset(new TaskPool(options.workers != 0 ? options.workers : std::thread::hardware_concurrency()));
+    }
+    else
+    {
+        for (int i = 0; i < numThreads; ++i)
+        {
+            threads.emplace_back(MarkerThread(i + 1, array, mtx, cvStart, controls[i], startSignal, settings));
+        }
+    }
+
+    // Markers are parked on cvStart, so pinning here still precedes their first mark.
+    std::vector<int> pinnedCpus;
+    if (options.pinPolicy != PinPolicy::None)
+    {
+        pinnedCpus = pinMarkers(pooled ? pool->threads() : threads, options);
+        if (!scripted)
+        {
+            printPinning(options.pinPolicy, pinnedCpus, std::cout);
+        }
+    }
+
+    auto startTime = std::chrono::steady_clock::now();
+    if (pooled)
+    {
+        for (auto& task : tasks)
+        {
+            pool->submit(task.get());
+        }
+    }
+    else
+    {
+        std::lock_guard<RunMutex> lock(mtx);
+        startSignal.store(true);
+        cvStart.notify_all();
+    }
+
+    int rounds = 0;
+    size_t schedulePosition = 0;
+    VictimPicker picker(options.victimPolicy, options.victimSeed);
+    bool allTerminated = false;
+    DeadlockStats deadlocks;
+    if (detector)
+    {
+        deadlocks = breakDeadlocks(*detector, mtx, controls, threads, metrics, options.victimCost, !scripted);
+        rounds = deadlocks.rounds;
+        allTerminated = true;
+    }
+    while (!allTerminated)
+    {
+        auto roundStart = std::chrono::steady_clock::now();
+        if (pooled)
+        {
+            roster.waitAllParked();
+        }
+        else if (barrier)
+        {
+            barrier->waitAllBlocked();
+        }
+        else
+        {
+            for (int i = 0; i < numThreads; ++i)
             {
-                std::cerr << "Thread " << threadToTerminate << " has already terminated." << std::endl;
-                continue;
+                RunLock lock(mtx);
+                MarkerControl& control = controls[i];
+                control.cvContinue.wait(lock, [&control] { return !control.continueSignal.load(); });
             }
+        }
+        RoundTiming timing;
+        timing.waitMs = msSince(roundStart);
 
-            terminateSignal[threadToTerminate - 1] = true;
-            cvContinue[threadToTerminate - 1].notify_one();
-
+        int threadToTerminate;
+        if (options.victimPolicy != VictimPolicy::Prompt)
+        {
+            threadToTerminate = picker.next(controls, counters);
+            if (!scripted)
             {
-                std::unique_lock<std::mutex> lock(mtx);
-                cvContinue[threadToTerminate - 1].wait(lock, [&terminateSignal, threadToTerminate] { return terminateSignal[threadToTerminate - 1]; });
+                std::cout << "Terminating thread " << threadToTerminate << " (" << victimPolicyName(options.victimPolicy) << ")" << std::endl;
             }
+        }
+        else if (scripted)
+        {
+            threadToTerminate = nextScheduledVictim(options.terminationSchedule, schedulePosition, controls);
+        }
+        else
+        {
+            showArray(array, options.view, counters, occupancy.get());
+
+            std::cout << "Enter the number of the thread to terminate: ";
+            std::cin >> threadToTerminate;
+        }
+
+        if (threadToTerminate < 1 || threadToTerminate > numThreads)
+        {
+            std::cerr << "Invalid thread number." << std::endl;
+            continue;
+        }
+
+        MarkerControl& victim = controls[threadToTerminate - 1];
+        if (victim.terminateSignal.load())
+        {
+            std::cerr << "Thread " << threadToTerminate << " has already terminated." << std::endl;
+            continue;
+        }
+
+        timing.victim = threadToTerminate;
+        auto terminateStart = std::chrono::steady_clock::now();
+        if (pooled)
+        {
+            victim.terminateSignal.store(true);
+            roster.unparkOne();
+            pool->submit(tasks[threadToTerminate - 1].get());
+            roster.waitAllParked();
+        }
+        else if (barrier)
+        {
+            barrier->terminate(victim);
+        }
+        else
+        {
+            std::lock_guard<RunMutex> lock(mtx);
+            victim.terminateSignal.store(true);
+            victim.cvContinue.notify_one();
+        }
+        if (!pooled)
+        {
             threads[threadToTerminate - 1].join();
+        }
+        timing.terminateMs = msSince(terminateStart);
+        ++rounds;
 
-            printArray(array);
+        if (!scripted)
+        {
+            showArray(array, options.view, counters, occupancy.get());
+        }
 
-            allTerminated = true;
-            for (const auto& t : threads)
+        allTerminated = true;
+        for (const auto& t : threads)
+        {
+            if (t.joinable())
             {
-                if (t.joinable())
+                allTerminated = false;
+                break;
+            }
+        }
+        if (pooled)
+        {
+            allTerminated = roster.live() == 0;
+        }
+
+        auto resumeStart = std::chrono::steady_clock::now();
+        if (!allTerminated && pooled)
+        {
+            roster.unparkAll();
+            for (int i = 0; i < numThreads; ++i)
+            {
+                if (!controls[i].terminateSignal.load())
                 {
-                    allTerminated = false;
-                    break;
+                    controls[i].continueSignal.store(true);
+                    pool->submit(tasks[i].get());
                 }
             }
-
-            if (!allTerminated)
+        }
+        else if (!allTerminated && barrier)
+        {
+            barrier->resume();
+        }
+        else if (!allTerminated)
+        {
+            for (int i = 0; i < numThreads; ++i)
             {
-                for (int i = 0; i < numThreads; ++i)
+                if (!controls[i].terminateSignal.load())
                 {
-                    if (!terminateSignal[i])
-                    {
-                        continueSignal[i] = true;
-                        cvContinue[i].notify_one();
-                    }
+                    std::lock_guard<RunMutex> lock(mtx);
+                    controls[i].continueSignal.store(true);
+                    controls[i].cvContinue.notify_one();
                 }
             }
         }
+        timing.resumeMs = msSince(resumeStart);
+        metrics.addRound(timing);
+    }
+
+    std::chrono::duration<double, std::milli> wall = std::chrono::steady_clock::now() - startTime;
+    double flushMs = array.mapping() != nullptr ? array.mapping()->flush() : 0.0;
+    if (exporter)
+    {
+        exporter->finish();
+    }
+#ifdef LAB3_PROFILE_LOCKS
+    mtx.report(std::cout);
+#endif
+    if (scripted)
+    {
+        printRunSummary(wall.count(), rounds, counters);
+        if (options.victimPolicy != VictimPolicy::Prompt)
+        {
+            printDrainSummary(options.victimPolicy, wall.count(), rounds);
+        }
+        if (array.placement() != nullptr)
+        {
+            printPlacement(*array.placement(), std::cout);
+        }
+        if (!pinnedCpus.empty())
+        {
+            printPinning(options.pinPolicy, pinnedCpus, std::cout);
+        }
+        if (pooled)
+        {
+            std::cout << "scheduler=pool workers=" << pool->workers() << " steals=" << pool->steals() << std::endl;
+        }
+        if (options.claimCells > 1)
+        {
+            printClaimSummary(wall.count(), options.claimCells, counters.totals());
+        }
+        if (detector)
+        {
+            std::cout << "deadlocks=" << detector->detected() << " victim=" << victimCostName(options.victimCost)
+                << " resolve_us_max=" << deadlocks.resolveUsMax
+                << " resolve_us_avg=" << (rounds > 0 ? deadlocks.resolveUsTotal / rounds : 0.0) << std::endl;
+        }
+        if (array.mapping() != nullptr)
+        {
+            printMappingSummary(*array.mapping(), PagingSample::now().since(pagingAtStart), flushMs);
+        }
+    }
+    else if (options.victimPolicy != VictimPolicy::Prompt)
+    {
+        printDrainSummary(options.victimPolicy, wall.count(), rounds);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    try
+    {
+        RunOptions options = parseOptions(argc, argv);
+        bool scripted = options.scripted();
+
+        int arraySize = options.arraySize;
+        if (!scripted)
+        {
+            std::cout << "Enter the size of the array: ";
+            std::cin >> arraySize;
+        }
+
+        if (arraySize <= 0)
+        {
+            throw std::invalid_argument("Array size must be positive.");
+        }
+
+        int numThreads = options.numThreads;
+        if (!scripted)
+        {
+            std::cout << "Enter the number of marker threads: ";
+            std::cin >> numThreads;
+        }
+
+        if (numThreads <= 0)
+        {
+            throw std::invalid_argument("Number of threads must be positive.");
+        }
+
+        if (options.claimCells > arraySize)
+        {
+            throw std::invalid_argument("--claim-cells cannot exceed the array size.");
+        }
+
+        if (numThreads <= UINT8_MAX)
+        {
+            runMarkers<uint8_t>(options, arraySize, numThreads, scripted);
+        }
+        else if (numThreads <= UINT16_MAX)
+        {
+            runMarkers<uint16_t>(options, arraySize, numThreads, scripted);
+        }
+        else
+        {
+            runMarkers<uint32_t>(options, arraySize, numThreads, scripted);
+        }
     }
     catch (const std::exception& e)
     {
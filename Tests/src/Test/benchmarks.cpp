@@ -0,0 +1,396 @@
+#include <benchmark/benchmark.h>
+#include <condition_variable>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "marker_thread.h"
+#include "../shared_array.h"
+#include "../striped_locks.h"
+#include "../ownership_journal.h"
+#include "../marker_rng.h"
+#include "../array_output.h"
+#include "../ownership_summary.h"
+#include "../occupancy_bitmap.h"
+#include "../round_barrier.h"
+
+// Шаг "проверить и пометить" через MarkerThread::markOnce без пауз. Неудачная попытка
+// освобождает всё, что маркер успел пометить, как при завершении, чтобы массив не
+// заполнялся до конца.
+namespace
+{
+    SharedArray* markArray = nullptr;
+    StripedLocks* markStripes = nullptr;
+    RunMutex markMutex;
+    RunCondition markStart;
+    std::atomic<bool> markStartSignal(false);
+
+    void setUpMarkArray(const benchmark::State& state)
+    {
+        markArray = new SharedArray(static_cast<size_t>(state.range(0)));
+        markStripes = new StripedLocks(markArray->size(), 64);
+    }
+
+    void tearDownMarkArray(const benchmark::State&)
+    {
+        delete markStripes;
+        delete markArray;
+        markStripes = nullptr;
+        markArray = nullptr;
+    }
+
+    void runMarkSteps(benchmark::State& state, LockMode mode)
+    {
+        int id = state.thread_index() + 1;
+        MarkerSettings settings;
+        settings.lockMode = mode;
+        settings.stripes = markStripes;
+        settings.work.kind = WorkKind::None;
+        settings.verbose = false;
+        MarkerControl control;
+        MarkerThread<uint32_t> marker(id, *markArray, markMutex, markStart, control, markStartSignal, settings);
+
+        IndexBatch indices(id, static_cast<uint32_t>(markArray->size()));
+        for (auto _ : state)
+        {
+            std::unique_lock<RunMutex> lock(markMutex, std::defer_lock);
+            if (mode == LockMode::Global)
+            {
+                lock.lock();
+            }
+            if (!marker.markOnce(static_cast<int>(indices.next())))
+            {
+                marker.releaseAll();
+            }
+        }
+        if (mode == LockMode::Global)
+        {
+            std::lock_guard<RunMutex> lock(markMutex);
+            marker.releaseAll();
+        }
+        else
+        {
+            marker.releaseAll();
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+
+    class NullBuffer : public std::streambuf
+    {
+    protected:
+        int overflow(int c) override
+        {
+            return c;
+        }
+
+        std::streamsize xsputn(const char*, std::streamsize count) override
+        {
+            return count;
+        }
+    };
+}
+
+static void BM_MarkGlobalLock(benchmark::State& state)
+{
+    runMarkSteps(state, LockMode::Global);
+}
+BENCHMARK(BM_MarkGlobalLock)->Setup(setUpMarkArray)->Teardown(tearDownMarkArray)
+    ->ArgsProduct({ { 1 << 10, 1 << 20 } })->ThreadRange(1, 8)->UseRealTime();
+
+static void BM_MarkStripedLock(benchmark::State& state)
+{
+    runMarkSteps(state, LockMode::Striped);
+}
+BENCHMARK(BM_MarkStripedLock)->Setup(setUpMarkArray)->Teardown(tearDownMarkArray)
+    ->ArgsProduct({ { 1 << 10, 1 << 20 } })->ThreadRange(1, 8)->UseRealTime();
+
+static void BM_MarkAtomicCas(benchmark::State& state)
+{
+    runMarkSteps(state, LockMode::Atomic);
+}
+BENCHMARK(BM_MarkAtomicCas)->Setup(setUpMarkArray)->Teardown(tearDownMarkArray)
+    ->ArgsProduct({ { 1 << 10, 1 << 20 } })->ThreadRange(1, 8)->UseRealTime();
+
+// Очистка при завершении: один маркер из range(1) владеет своей долей массива.
+static void fillShare(SharedArray& array, OwnershipJournal& journal, int markers)
+{
+    for (size_t i = 0; i < array.size(); i += markers)
+    {
+        array.store(i, 1);
+        journal.record(i);
+    }
+}
+
+static void BM_CleanupFullScan(benchmark::State& state)
+{
+    SharedArray array(static_cast<size_t>(state.range(0)));
+    OwnershipJournal journal;
+    fillShare(array, journal, static_cast<int>(state.range(1)));
+    for (auto _ : state)
+    {
+        for (size_t i = 0; i < array.size(); ++i)
+        {
+            if (array.load(i) == 1)
+            {
+                array.store(i, 0);
+            }
+        }
+        state.PauseTiming();
+        journal.forEach([&](size_t index) { array.store(index, 1); });
+        state.ResumeTiming();
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0) * sizeof(int));
+}
+BENCHMARK(BM_CleanupFullScan)->ArgsProduct({ { 1 << 16, 1 << 22 }, { 1, 8, 64 } });
+
+static void BM_CleanupJournal(benchmark::State& state)
+{
+    SharedArray array(static_cast<size_t>(state.range(0)));
+    OwnershipJournal journal;
+    fillShare(array, journal, static_cast<int>(state.range(1)));
+    for (auto _ : state)
+    {
+        journal.forEach([&](size_t index) { array.store(index, 0); });
+        state.PauseTiming();
+        journal.forEach([&](size_t index) { array.store(index, 1); });
+        state.ResumeTiming();
+    }
+    state.counters["journal_bytes"] = static_cast<double>(journal.memoryBytes());
+}
+BENCHMARK(BM_CleanupJournal)->ArgsProduct({ { 1 << 16, 1 << 22 }, { 1, 8, 64 } });
+
+static void BM_PrintArray(benchmark::State& state)
+{
+    SharedArray array(static_cast<size_t>(state.range(0)));
+    Xoshiro256StarStar rng(1);
+    for (size_t i = 0; i < array.size(); ++i)
+    {
+        array.store(i, static_cast<int>(rng.below(16)));
+    }
+
+    NullBuffer buffer;
+    std::ostream out(&buffer);
+    for (auto _ : state)
+    {
+        printArray(array, out);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_PrintArray)->Arg(1 << 10)->Arg(1 << 16)->Arg(1 << 20);
+
+// Ширина ячейки: uint8_t хватает до 255 потоков, uint32_t — запас на любое число.
+template <typename Cell>
+static void BM_SummarizeOwnership(benchmark::State& state)
+{
+    BasicSharedArray<Cell> array(static_cast<size_t>(state.range(0)));
+    const int markers = static_cast<int>(state.range(1));
+    Xoshiro256StarStar rng(1);
+    for (size_t i = 0; i < array.size(); ++i)
+    {
+        array.store(i, static_cast<int>(rng.below(static_cast<uint32_t>(markers) + 1)));
+    }
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(summarizeOwnership(array, markers));
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0) * sizeof(Cell));
+}
+BENCHMARK_TEMPLATE(BM_SummarizeOwnership, uint8_t)->ArgsProduct({ { 1 << 16, 1 << 22 }, { 8, 200 } });
+BENCHMARK_TEMPLATE(BM_SummarizeOwnership, uint32_t)->ArgsProduct({ { 1 << 16, 1 << 22 }, { 8, 200 } });
+
+// Сколько ячеек свободно: проход по массиву против popcount по битовой карте занятости.
+static void fillHalf(SharedArray& array, OccupancyBitmap& bitmap)
+{
+    Xoshiro256StarStar rng(1);
+    for (size_t i = 0; i < array.size(); ++i)
+    {
+        if (rng.below(2) == 1)
+        {
+            array.store(i, 1);
+            bitmap.set(i);
+        }
+    }
+}
+
+static void BM_CountFreeScan(benchmark::State& state)
+{
+    SharedArray array(static_cast<size_t>(state.range(0)));
+    OccupancyBitmap bitmap(array.size());
+    fillHalf(array, bitmap);
+    for (auto _ : state)
+    {
+        size_t freeCells = 0;
+        for (size_t i = 0; i < array.size(); ++i)
+        {
+            freeCells += array.load(i) == 0 ? 1 : 0;
+        }
+        benchmark::DoNotOptimize(freeCells);
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0) * sizeof(int));
+}
+BENCHMARK(BM_CountFreeScan)->Arg(1 << 16)->Arg(1 << 22);
+
+static void BM_CountFreeBitmap(benchmark::State& state)
+{
+    SharedArray array(static_cast<size_t>(state.range(0)));
+    OccupancyBitmap bitmap(array.size());
+    fillHalf(array, bitmap);
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(bitmap.freeCells());
+    }
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(bitmap.memoryBytes()));
+}
+BENCHMARK(BM_CountFreeBitmap)->Arg(1 << 16)->Arg(1 << 22);
+
+// Раунд "заблокирован / продолжай" настоящих MarkerThread: клетка 0 занята чужим
+// номером, и каждый из range(0) маркеров, начиная с неё, сразу блокируется. За одну
+// итерацию main дожидается блокировки всех и продолжает их, как в обычном прогоне:
+// по MarkerControl (handshake) или через RoundBarrier (barrier).
+static void runBlockContinueRounds(benchmark::State& state, RoundMode mode)
+{
+    const int numThreads = static_cast<int>(state.range(0));
+    SharedArray array(16);
+    array.store(0, static_cast<uint32_t>(numThreads) + 1);
+    RunMutex mtx;
+    RunCondition cvStart;
+    std::atomic<bool> startSignal(false);
+    std::vector<MarkerControl> controls(numThreads);
+    RoundBarrier barrier(mtx, controls);
+
+    MarkerSettings settings;
+    settings.work.kind = WorkKind::None;
+    settings.barrier = mode == RoundMode::Barrier ? &barrier : nullptr;
+    settings.verbose = false;
+
+    std::vector<std::thread> markers;
+    for (int i = 0; i < numThreads; ++i)
+    {
+        MarkerThread<uint32_t> marker(i + 1, array, mtx, cvStart, controls[i], startSignal, settings);
+        marker.setFixedIndex(0);
+        markers.emplace_back(std::move(marker));
+    }
+    {
+        std::lock_guard<RunMutex> lock(mtx);
+        startSignal.store(true);
+        cvStart.notify_all();
+    }
+
+    auto waitAllBlocked = [&]
+    {
+        if (mode == RoundMode::Barrier)
+        {
+            barrier.waitAllBlocked();
+            return;
+        }
+        for (auto& control : controls)
+        {
+            RunLock lock(mtx);
+            control.cvContinue.wait(lock, [&control] { return !control.continueSignal.load(); });
+        }
+    };
+
+    for (auto _ : state)
+    {
+        waitAllBlocked();
+        if (mode == RoundMode::Barrier)
+        {
+            barrier.resume();
+            continue;
+        }
+        for (auto& control : controls)
+        {
+            std::lock_guard<RunMutex> lock(mtx);
+            control.continueSignal.store(true);
+            control.cvContinue.notify_one();
+        }
+    }
+
+    waitAllBlocked();
+    for (auto& control : controls)
+    {
+        if (mode == RoundMode::Barrier)
+        {
+            barrier.terminate(control);
+            continue;
+        }
+        std::lock_guard<RunMutex> lock(mtx);
+        control.terminateSignal.store(true);
+        control.cvContinue.notify_one();
+    }
+    for (auto& t : markers)
+    {
+        t.join();
+    }
+    state.SetItemsProcessed(state.iterations() * numThreads);
+}
+
+static void BM_HandshakeRound(benchmark::State& state)
+{
+    runBlockContinueRounds(state, RoundMode::Handshake);
+}
+BENCHMARK(BM_HandshakeRound)->RangeMultiplier(4)->Range(1, 64)->UseRealTime();
+
+static void BM_BarrierRound(benchmark::State& state)
+{
+    runBlockContinueRounds(state, RoundMode::Barrier);
+}
+BENCHMARK(BM_BarrierRound)->RangeMultiplier(4)->Range(1, 64)->UseRealTime();
+
+// Раунд с завершением на RoundBarrier: жертва просыпается, выходит из ожидания и сразу
+// возвращается новым маркером. Остальные range(0) - 1 маркеров не просыпаются, поэтому
+// время раунда не должно расти с числом потоков.
+static void BM_BarrierTerminate(benchmark::State& state)
+{
+    const int numThreads = static_cast<int>(state.range(0));
+    RunMutex mtx;
+    std::vector<MarkerControl> controls(numThreads);
+    RoundBarrier barrier(mtx, controls);
+    std::atomic<bool> stop(false);
+
+    std::vector<std::thread> markers;
+    for (int i = 0; i < numThreads; ++i)
+    {
+        markers.emplace_back([&, i]
+        {
+            RunLock lock(mtx);
+            while (!barrier.arriveAndWait(lock, controls[i]) || !stop.load())
+            {
+                controls[i].terminateSignal.store(false);
+            }
+            barrier.depart();
+        });
+    }
+
+    barrier.waitAllBlocked();
+    long long wakeupsBefore = barrier.wakeups();
+    int victim = 0;
+    for (auto _ : state)
+    {
+        barrier.terminate(controls[victim]);
+        while (controls[victim].terminateSignal.load())
+        {
+            std::this_thread::yield();
+        }
+        barrier.waitAllBlocked();
+        victim = (victim + 1) % numThreads;
+    }
+    state.counters["wakeups_per_round"] = benchmark::Counter(
+        static_cast<double>(barrier.wakeups() - wakeupsBefore), benchmark::Counter::kAvgIterations);
+
+    stop.store(true);
+    for (auto& control : controls)
+    {
+        barrier.terminate(control);
+    }
+    for (auto& t : markers)
+    {
+        t.join();
+    }
+}
+BENCHMARK(BM_BarrierTerminate)->RangeMultiplier(8)->Range(4, 4096)->UseRealTime();
+
+BENCHMARK_MAIN();
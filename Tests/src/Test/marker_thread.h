@@ -1,24 +1,28 @@
 // marker_thread.h
 #pragma once
+#include <algorithm>
 #include <vector>
 #include <mutex>
 #include <condition_variable>
 #include <atomic>
 #include <chrono>
+#include <iostream>
+#include "../shared_array.h"
+#include "../striped_locks.h"
+#include "../marker_settings.h"
+#include "../marker_control.h"
+#include "../ownership_journal.h"
+#include "../marker_rng.h"
 
+template <typename Cell>
 class MarkerThread
 {
 public:
-    // Добавляем статическую переменную для управления паузами в тестах
-    static std::chrono::milliseconds sleepDuration;
-
-    MarkerThread(int id, std::vector<int>& array, std::mutex& mtx, 
-                std::condition_variable& cvStart, std::vector<std::condition_variable>& cvContinue, 
-                std::vector<bool>& continueSignal, std::vector<bool>& terminateSignal, 
-                std::atomic<bool>& startSignal)
-        : id_(id), array_(array), mtx_(mtx), cvStart_(cvStart), cvContinue_(cvContinue),
-        continueSignal_(continueSignal), terminateSignal_(terminateSignal), startSignal_(startSignal),
-        fixedIndex_(-1), useFixedIndex_(false)
+    MarkerThread(int id, BasicSharedArray<Cell>& array, RunMutex& mtx, RunCondition& cvStart,
+        MarkerControl& control, std::atomic<bool>& startSignal, const MarkerSettings& settings = MarkerSettings())
+        : id_(id), array_(array), mtx_(mtx), cvStart_(cvStart), control_(control), startSignal_(startSignal),
+        settings_(settings), counters_(settings.counters != nullptr ? &settings.counters->forMarker(id) : nullptr),
+        indices_(static_cast<uint64_t>(id), static_cast<uint32_t>(array.size())), fixedIndex_(-1), useFixedIndex_(false)
     {
     }
 
@@ -26,52 +30,101 @@ public:
     {
         try
         {
-            std::unique_lock<std::mutex> lock(mtx_);
+            RunLock lock(mtx_, std::defer_lock);
+            acquire(lock);
             cvStart_.wait(lock, [this] { return startSignal_.load(); });
 
-            srand(id_);
+            // Only the global mode keeps the shared mutex while marking; the other modes
+            // take it for the block/continue handshake alone.
+            bool holdLock = settings_.lockMode == LockMode::Global;
+            if (!holdLock)
+            {
+                lock.unlock();
+            }
 
             int markedCount = 0;
-            while (!terminateSignal_[id_ - 1])
+            while (!control_.terminateSignal.load(std::memory_order_acquire))
             {
                 int randomIndex;
                 if (useFixedIndex_) {
                     randomIndex = fixedIndex_;
                 } else {
-                    randomIndex = rand() % array_.size();
+                    randomIndex = static_cast<int>(indices_.next());
+                }
+
+                if (settings_.claimCells > 1 ? tryMarkMany(randomIndex) : tryMark(randomIndex))
+                {
+                    markedCount += settings_.claimCells;
+                    if (counters_ != nullptr)
+                    {
+                        MarkerCounters::bump(counters_->marked, settings_.claimCells);
+                    }
+                    continue;
                 }
-                
-                if (array_[randomIndex] == 0)
+
+                if (counters_ != nullptr)
                 {
-                    std::this_thread::sleep_for(sleepDuration);
-                    array_[randomIndex] = id_;
-                    std::this_thread::sleep_for(sleepDuration);
-                    ++markedCount;
+                    counters_->noteBlocked();
                 }
-                else
+                if (!holdLock)
+                {
+                    acquire(lock);
+                }
+
+                if (settings_.verbose)
                 {
                     std::cout << "Thread " << id_ << ": marked " << markedCount << " elements, cannot mark index " << randomIndex << std::endl;
-                    continueSignal_[id_ - 1] = false;
-                    cvContinue_[id_ - 1].notify_one();
+                }
+                if (settings_.barrier != nullptr)
+                {
+                    WaitTimer timer(waitCounter(&MarkerCounters::condWaitNs));
+                    if (settings_.barrier->arriveAndWait(lock, control_))
+                    {
+                        break;
+                    }
+                }
+                else
+                {
+                    if (settings_.deadlocks != nullptr && !settings_.deadlocks->block(id_, array_.load(randomIndex)))
+                    {
+                        if (!holdLock)
+                        {
+                            lock.unlock();
+                        }
+                        continue;
+                    }
+                    control_.continueSignal.store(false);
+                    control_.cvContinue.notify_one();
 
-                    cvContinue_[id_ - 1].wait(lock, [this] { return continueSignal_[id_ - 1] || terminateSignal_[id_ - 1]; });
-                    if (terminateSignal_[id_ - 1])
+                    {
+                        WaitTimer timer(waitCounter(&MarkerCounters::condWaitNs));
+                        control_.cvContinue.wait(lock, [this] { return control_.continueSignal.load() || control_.terminateSignal.load(); });
+                    }
+                    if (control_.terminateSignal.load())
                     {
                         break;
                     }
                 }
-            }
 
-            for (size_t i = 0; i < array_.size(); ++i)
-            {
-                if (array_[i] == id_)
+                if (!holdLock)
                 {
-                    array_[i] = 0;
+                    lock.unlock();
                 }
             }
 
-            terminateSignal_[id_ - 1] = true;
-            cvContinue_[id_ - 1].notify_one();
+            if (!lock.owns_lock())
+            {
+                acquire(lock);
+            }
+
+            clearMarks();
+
+            control_.terminateSignal.store(true);
+            if (settings_.barrier != nullptr)
+            {
+                settings_.barrier->depart();
+            }
+            control_.cvContinue.notify_one();
         }
         catch (const std::exception& e)
         {
@@ -85,18 +138,285 @@ public:
         useFixedIndex_ = true;
     }
 
+    // Один шаг "проверить и пометить" без цикла потока; в режиме global мьютекс берёт вызывающий
+    bool markOnce(int index) {
+        return tryMark(index);
+    }
+
+    void releaseAll() {
+        clearMarks();
+    }
+
 private:
+    // The wait counter to charge, or none when waits are not being timed.
+    std::atomic<long long>* waitCounter(std::atomic<long long> MarkerCounters::* counter)
+    {
+        return settings_.timeWaits && counters_ != nullptr ? &(counters_->*counter) : nullptr;
+    }
+
+    template <typename Lockable>
+    void acquire(Lockable& lockable)
+    {
+        WaitTimer timer(waitCounter(&MarkerCounters::lockWaitNs));
+        lockable.lock();
+    }
+
+    // The bitmap answers from one bit per cell only in the global mode, where its bits
+    // change under the same mutex as the cells. Elsewhere a bit may lag its cell, so
+    // the cell itself is read.
+    bool cellFree(int index) const
+    {
+        if (settings_.occupancy != nullptr && settings_.lockMode == LockMode::Global)
+        {
+            return !settings_.occupancy->test(index);
+        }
+        return array_.load(index) == 0;
+    }
+
+    bool markCell(int index)
+    {
+        if (!cellFree(index))
+        {
+            return false;
+        }
+
+        settings_.work.perform();
+        array_.store(index, id_);
+        if (settings_.occupancy != nullptr)
+        {
+            settings_.occupancy->set(index);
+        }
+        settings_.work.perform();
+        return true;
+    }
+
+    // A failed CAS means another marker got the cell first, which is the same
+    // "cannot mark index" event as finding it already taken.
+    bool claimCell(int index)
+    {
+        if (!cellFree(index))
+        {
+            return false;
+        }
+
+        settings_.work.perform();
+        if (!array_.claim(index, id_))
+        {
+            return false;
+        }
+        if (settings_.occupancy != nullptr)
+        {
+            settings_.occupancy->set(index);
+        }
+        settings_.work.perform();
+        return true;
+    }
+
+    bool tryMark(int index)
+    {
+        bool marked;
+        switch (settings_.lockMode)
+        {
+        case LockMode::Striped:
+        {
+            std::mutex& stripe = settings_.stripes->forIndex(index);
+            acquire(stripe);
+            std::lock_guard<std::mutex> stripeLock(stripe, std::adopt_lock);
+            marked = markCell(index);
+            break;
+        }
+        case LockMode::Atomic:
+            marked = claimCell(index);
+            break;
+        default:
+            marked = markCell(index);
+            break;
+        }
+
+        if (marked)
+        {
+            journal_.record(index);
+        }
+        return marked;
+    }
+
+    // Marks cells whose owners were all checked under the caller's locks.
+    bool markAll(const std::vector<size_t>& cells, int& index)
+    {
+        for (size_t cell : cells)
+        {
+            if (!cellFree(static_cast<int>(cell)))
+            {
+                index = static_cast<int>(cell);
+                return false;
+            }
+        }
+
+        settings_.work.perform();
+        for (size_t cell : cells)
+        {
+            array_.store(cell, id_);
+            if (settings_.occupancy != nullptr)
+            {
+                settings_.occupancy->set(cell);
+            }
+        }
+        settings_.work.perform();
+        return true;
+    }
+
+    // Stripes are always taken in ascending order, so two markers that want
+    // overlapping stripes cannot hold one each and wait for the other.
+    bool markStriped(const std::vector<size_t>& cells, int& index)
+    {
+        stripeBuffer_.clear();
+        for (size_t cell : cells)
+        {
+            stripeBuffer_.push_back(cell / settings_.stripes->stripeSize());
+        }
+        std::sort(stripeBuffer_.begin(), stripeBuffer_.end());
+        stripeBuffer_.erase(std::unique(stripeBuffer_.begin(), stripeBuffer_.end()), stripeBuffer_.end());
+
+        for (size_t stripe : stripeBuffer_)
+        {
+            acquire(settings_.stripes->stripe(stripe));
+        }
+        bool marked = markAll(cells, index);
+        for (auto stripe = stripeBuffer_.rbegin(); stripe != stripeBuffer_.rend(); ++stripe)
+        {
+            settings_.stripes->stripe(*stripe).unlock();
+        }
+        return marked;
+    }
+
+    // CAS one cell after another and give back the ones already won when a later
+    // CAS loses, so nothing stays claimed while the marker is blocked.
+    bool claimAll(const std::vector<size_t>& cells, int& index)
+    {
+        for (size_t cell : cells)
+        {
+            if (!cellFree(static_cast<int>(cell)))
+            {
+                index = static_cast<int>(cell);
+                return false;
+            }
+        }
+
+        settings_.work.perform();
+        for (size_t i = 0; i < cells.size(); ++i)
+        {
+            if (!array_.claim(cells[i], id_))
+            {
+                for (size_t j = 0; j < i; ++j)
+                {
+                    array_.store(cells[j], 0);
+                }
+                index = static_cast<int>(cells[i]);
+                return false;
+            }
+        }
+        for (size_t cell : cells)
+        {
+            if (settings_.occupancy != nullptr)
+            {
+                settings_.occupancy->set(cell);
+            }
+        }
+        settings_.work.perform();
+        return true;
+    }
+
+    // All-or-nothing claim of settings_.claimCells distinct cells, `index` first. On
+    // failure `index` is the cell that was taken and none of them is held.
+    bool tryMarkMany(int& index)
+    {
+        claimBuffer_.assign(1, static_cast<size_t>(index));
+        while (claimBuffer_.size() < static_cast<size_t>(settings_.claimCells))
+        {
+            size_t next = indices_.next();
+            if (std::find(claimBuffer_.begin(), claimBuffer_.end(), next) == claimBuffer_.end())
+            {
+                claimBuffer_.push_back(next);
+            }
+        }
+
+        bool marked;
+        switch (settings_.lockMode)
+        {
+        case LockMode::Striped:
+            marked = markStriped(claimBuffer_, index);
+            break;
+        case LockMode::Atomic:
+            marked = claimAll(claimBuffer_, index);
+            break;
+        default:
+            marked = markAll(claimBuffer_, index);
+            break;
+        }
+
+        if (marked)
+        {
+            for (size_t cell : claimBuffer_)
+            {
+                journal_.record(cell);
+            }
+        }
+        return marked;
+    }
+
+    // Walks only the cells this marker claimed instead of scanning the whole array.
+    // Only the owner ever resets a non-zero cell, so a plain store is enough even in
+    // the lock-free mode.
+    void clearMarks()
+    {
+        journal_.forEach([this](size_t index)
+        {
+            if (settings_.lockMode == LockMode::Striped)
+            {
+                std::mutex& stripe = settings_.stripes->forIndex(index);
+                acquire(stripe);
+                std::lock_guard<std::mutex> stripeLock(stripe, std::adopt_lock);
+                releaseCell(index);
+            }
+            else
+            {
+                releaseCell(index);
+            }
+        });
+
+        if (counters_ != nullptr)
+        {
+            MarkerCounters::bump(counters_->released, static_cast<long long>(journal_.size()));
+        }
+        if (settings_.verbose)
+        {
+            std::cout << "Thread " << id_ << ": released " << journal_.size() << " elements, journal " << journal_.memoryBytes()
+                << " bytes vs " << array_.size() * sizeof(Cell) << " bytes for a full scan" << std::endl;
+        }
+        journal_.clear();
+    }
+
+    void releaseCell(size_t index)
+    {
+        array_.store(index, 0);
+        if (settings_.occupancy != nullptr)
+        {
+            settings_.occupancy->reset(index);
+        }
+    }
+
     int id_;
-    std::vector<int>& array_;
-    std::mutex& mtx_;
-    std::condition_variable& cvStart_;
-    std::vector<std::condition_variable>& cvContinue_;
-    std::vector<bool>& continueSignal_;
-    std::vector<bool>& terminateSignal_;
+    BasicSharedArray<Cell>& array_;
+    RunMutex& mtx_;
+    RunCondition& cvStart_;
+    MarkerControl& control_;
     std::atomic<bool>& startSignal_;
+    MarkerSettings settings_;
+    MarkerCounters* counters_;
+    OwnershipJournal journal_;
+    IndexBatch indices_;
+    std::vector<size_t> claimBuffer_;
+    std::vector<size_t> stripeBuffer_;
     int fixedIndex_;
     bool useFixedIndex_;
 };
-
-// Инициализация статической переменной
-std::chrono::milliseconds MarkerThread::sleepDuration = std::chrono::milliseconds(5);
\ No newline at end of file
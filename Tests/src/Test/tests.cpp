@@ -2,44 +2,41 @@
 #include <boost/test/unit_test.hpp>
 #include <thread>
 #include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <fstream>
+#include <sstream>
 #include "marker_thread.h"
+#include "../run_options.h"
+#include "../array_output.h"
+#include "../ownership_summary.h"
+#include "../marker_task.h"
+#include "../marker_coroutine.h"
 
 class MarkerThreadTestFixture {
 public:
-    MarkerThreadTestFixture() {
-        arraySize = 10;
-        array.resize(arraySize, 0);
+    MarkerThreadTestFixture() : arraySize(10), array(arraySize) {
         mtx = std::make_shared<std::mutex>();
         cvStart = std::make_shared<std::condition_variable>();
-        cvContinue = std::make_shared<std::vector<std::condition_variable>>(1);
-        continueSignal = std::make_shared<std::vector<bool>>(1, true);
-        terminateSignal = std::make_shared<std::vector<bool>>(1, false);
+        control = std::make_shared<MarkerControl>();
         startSignal = std::make_shared<std::atomic<bool>>(false);
-        
-        originalSleepDuration = MarkerThread::sleepDuration;
-        MarkerThread::sleepDuration = std::chrono::milliseconds(1);
-    }
 
-    ~MarkerThreadTestFixture() {
-        MarkerThread::sleepDuration = originalSleepDuration;
+        // Короткие паузы, чтобы тесты шли быстро
+        settings.work.duration = std::chrono::milliseconds(1);
     }
 
-    static std::chrono::milliseconds originalSleepDuration;
-
     int arraySize;
-    std::vector<int> array;
+    SharedArray array;
     std::shared_ptr<std::mutex> mtx;
     std::shared_ptr<std::condition_variable> cvStart;
-    std::shared_ptr<std::vector<std::condition_variable>> cvContinue;
-    std::shared_ptr<std::vector<bool>> continueSignal;
-    std::shared_ptr<std::vector<bool>> terminateSignal;
+    std::shared_ptr<MarkerControl> control;
     std::shared_ptr<std::atomic<bool>> startSignal;
+    MarkerSettings settings;
 };
 
-std::chrono::milliseconds MarkerThreadTestFixture::originalSleepDuration;
-
 BOOST_FIXTURE_TEST_CASE(ThreadStartsAfterSignal, MarkerThreadTestFixture) {
-    MarkerThread thread(1, array, *mtx, *cvStart, *cvContinue, *continueSignal, *terminateSignal, *startSignal);
+    MarkerThread thread(1, array, *mtx, *cvStart, *control, *startSignal, settings);
     
     std::atomic<bool> threadStarted(false);
     std::thread t([&](){
@@ -58,14 +55,14 @@ BOOST_FIXTURE_TEST_CASE(ThreadStartsAfterSignal, MarkerThreadTestFixture) {
     std::this_thread::sleep_for(std::chrono::milliseconds(10));
     BOOST_CHECK(threadStarted.load());
     
-    (*terminateSignal)[0] = true;
-    (*continueSignal)[0] = true;
-    cvContinue->at(0).notify_one();
+    control->terminateSignal = true;
+    control->continueSignal = true;
+    control->cvContinue.notify_one();
     t.join();
 }
 
 BOOST_FIXTURE_TEST_CASE(ThreadMarksElementsCorrectly, MarkerThreadTestFixture) {
-    MarkerThread thread(1, array, *mtx, *cvStart, *cvContinue, *continueSignal, *terminateSignal, *startSignal);
+    MarkerThread thread(1, array, *mtx, *cvStart, *control, *startSignal, settings);
     
     std::thread t([&](){ thread(); });
     
@@ -86,14 +83,14 @@ BOOST_FIXTURE_TEST_CASE(ThreadMarksElementsCorrectly, MarkerThreadTestFixture) {
     }
     BOOST_CHECK(foundMark);
     
-    (*terminateSignal)[0] = true;
-    (*continueSignal)[0] = true;
-    cvContinue->at(0).notify_one();
+    control->terminateSignal = true;
+    control->continueSignal = true;
+    control->cvContinue.notify_one();
     t.join();
 }
 
 BOOST_FIXTURE_TEST_CASE(ThreadClearsMarksOnTermination, MarkerThreadTestFixture) {
-    MarkerThread thread(1, array, *mtx, *cvStart, *cvContinue, *continueSignal, *terminateSignal, *startSignal);
+    MarkerThread thread(1, array, *mtx, *cvStart, *control, *startSignal, settings);
     
     std::thread t([&](){ thread(); });
     
@@ -105,9 +102,9 @@ BOOST_FIXTURE_TEST_CASE(ThreadClearsMarksOnTermination, MarkerThreadTestFixture)
     
     std::this_thread::sleep_for(std::chrono::milliseconds(100));
     
-    (*terminateSignal)[0] = true;
-    (*continueSignal)[0] = true;
-    cvContinue->at(0).notify_one();
+    control->terminateSignal = true;
+    control->continueSignal = true;
+    control->cvContinue.notify_one();
     t.join();
     
     for (int val : array) {
@@ -118,7 +115,7 @@ BOOST_FIXTURE_TEST_CASE(ThreadClearsMarksOnTermination, MarkerThreadTestFixture)
 BOOST_FIXTURE_TEST_CASE(ThreadDoesNotOverwriteOtherMarks, MarkerThreadTestFixture) {
     array[0] = 2;
     
-    MarkerThread thread(1, array, *mtx, *cvStart, *cvContinue, *continueSignal, *terminateSignal, *startSignal);
+    MarkerThread thread(1, array, *mtx, *cvStart, *control, *startSignal, settings);
     thread.setFixedIndex(0); 
     
     std::thread t([&](){ thread(); });
@@ -131,32 +128,26 @@ BOOST_FIXTURE_TEST_CASE(ThreadDoesNotOverwriteOtherMarks, MarkerThreadTestFixtur
     
     std::this_thread::sleep_for(std::chrono::milliseconds(100));
     
-    BOOST_CHECK_EQUAL(array[0], 2);
+    BOOST_CHECK_EQUAL(array.load(0), 2);
     
-    (*terminateSignal)[0] = true;
-    (*continueSignal)[0] = true;
-    cvContinue->at(0).notify_one();
+    control->terminateSignal = true;
+    control->continueSignal = true;
+    control->cvContinue.notify_one();
     t.join();
 }
 
 BOOST_FIXTURE_TEST_CASE(MultipleThreadsWorkCorrectly, MarkerThreadTestFixture) {
     const int numThreads = 3;
-    std::vector<std::shared_ptr<std::vector<bool>>> continueSignals(numThreads);
-    std::vector<std::shared_ptr<std::vector<bool>>> terminateSignals(numThreads);
-    std::vector<std::shared_ptr<std::vector<std::condition_variable>>> cvContinues(numThreads);
+    std::vector<MarkerControl> controls(numThreads);
     std::vector<std::shared_ptr<std::mutex>> mutexes(numThreads);
     
     for (int i = 0; i < numThreads; ++i) {
-        continueSignals[i] = std::make_shared<std::vector<bool>>(numThreads, true);
-        terminateSignals[i] = std::make_shared<std::vector<bool>>(numThreads, false);
-        cvContinues[i] = std::make_shared<std::vector<std::condition_variable>>(numThreads);
         mutexes[i] = std::make_shared<std::mutex>();
     }
     
     std::vector<std::thread> threads;
     for (int i = 0; i < numThreads; ++i) {
-        threads.emplace_back(MarkerThread(i+1, array, *mutexes[i], *cvStart, *cvContinues[i], 
-                      *continueSignals[i], *terminateSignals[i], *startSignal));
+        threads.emplace_back(MarkerThread(i+1, array, *mutexes[i], *cvStart, controls[i], *startSignal, settings));
     }
     
     {
@@ -172,9 +163,1128 @@ BOOST_FIXTURE_TEST_CASE(MultipleThreadsWorkCorrectly, MarkerThreadTestFixture) {
     }
     
     for (int i = 0; i < numThreads; ++i) {
-        (*terminateSignals[i])[i] = true;
-        (*continueSignals[i])[i] = true;
-        cvContinues[i]->at(i).notify_one();
+        controls[i].terminateSignal = true;
+        controls[i].continueSignal = true;
+        controls[i].cvContinue.notify_one();
+        threads[i].join();
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ControlBlocksSitOnSeparateCacheLines) {
+    BOOST_CHECK(alignof(MarkerControl) >= 64);
+    std::vector<MarkerControl> controls(2);
+    auto first = reinterpret_cast<std::uintptr_t>(&controls[0].terminateSignal);
+    auto second = reinterpret_cast<std::uintptr_t>(&controls[1].terminateSignal);
+    BOOST_CHECK(first / 64 != second / 64);
+    BOOST_CHECK(controls[0].continueSignal.load());
+    BOOST_CHECK(!controls[0].terminateSignal.load());
+}
+
+BOOST_FIXTURE_TEST_CASE(CountersTrackMarksReleasesAndBlocks, MarkerThreadTestFixture) {
+    const int numThreads = 3;
+    CounterBoard counters(numThreads);
+    BOOST_CHECK(alignof(MarkerCounters) >= 64);
+    settings.counters = &counters;
+    settings.lockMode = LockMode::Atomic;
+    settings.work.kind = WorkKind::None;
+    settings.verbose = false;
+    std::vector<MarkerControl> controls(numThreads);
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < numThreads; ++i) {
+        threads.emplace_back(MarkerThread(i + 1, array, *mtx, *cvStart, controls[i], *startSignal, settings));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(*mtx);
+        *startSignal = true;
+        cvStart->notify_all();
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(*mtx);
+        for (auto& control : controls) {
+            BOOST_CHECK(control.cvContinue.wait_for(lock, std::chrono::seconds(1), [&] { return !control.continueSignal.load(); }));
+        }
+        CounterTotals live = counters.totals();
+        size_t owned = 0;
+        for (int val : array) {
+            owned += val != 0 ? 1 : 0;
+        }
+        BOOST_CHECK_EQUAL(live.held(), static_cast<long long>(owned));
+        BOOST_CHECK_EQUAL(live.blocked, numThreads);
+
+        for (auto& control : controls) {
+            control.terminateSignal = true;
+            control.cvContinue.notify_one();
+        }
+    }
+
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    CounterTotals totals = counters.totals();
+    BOOST_CHECK_EQUAL(totals.held(), 0);
+    for (int id = 1; id <= numThreads; ++id) {
+        BOOST_CHECK_EQUAL(counters.forMarker(id).marked.load(), counters.forMarker(id).released.load());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(StripedLocksCoverWholeArray) {
+    StripedLocks stripes(10, 4);
+    BOOST_CHECK_EQUAL(stripes.stripeSize(), 3u);
+    BOOST_CHECK_EQUAL(stripes.count(), 4u);
+    BOOST_CHECK(&stripes.forIndex(0) == &stripes.stripe(0));
+    BOOST_CHECK(&stripes.forIndex(2) == &stripes.stripe(0));
+    BOOST_CHECK(&stripes.forIndex(3) == &stripes.stripe(1));
+    BOOST_CHECK(&stripes.forIndex(9) == &stripes.stripe(3));
+
+    StripedLocks clamped(3, 100);
+    BOOST_CHECK_EQUAL(clamped.count(), 3u);
+}
+
+BOOST_FIXTURE_TEST_CASE(StripedThreadsMarkAndClear, MarkerThreadTestFixture) {
+    const int numThreads = 2;
+    StripedLocks stripes(array.size(), 4);
+    settings.lockMode = LockMode::Striped;
+    settings.stripes = &stripes;
+    std::vector<MarkerControl> controls(numThreads);
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < numThreads; ++i) {
+        threads.emplace_back(MarkerThread(i + 1, array, *mtx, *cvStart, controls[i], *startSignal, settings));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(*mtx);
+        *startSignal = true;
+        cvStart->notify_all();
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    {
+        std::lock_guard<std::mutex> lock(*mtx);
+        for (int val : array) {
+            BOOST_CHECK(val >= 0 && val <= numThreads);
+        }
+        for (int i = 0; i < numThreads; ++i) {
+            controls[i].terminateSignal = true;
+            controls[i].cvContinue.notify_one();
+        }
+    }
+
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    for (int val : array) {
+        BOOST_CHECK_EQUAL(val, 0);
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(AtomicThreadsMarkAndClear, MarkerThreadTestFixture) {
+    const int numThreads = 3;
+    settings.lockMode = LockMode::Atomic;
+    std::vector<MarkerControl> controls(numThreads);
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < numThreads; ++i) {
+        threads.emplace_back(MarkerThread(i + 1, array, *mtx, *cvStart, controls[i], *startSignal, settings));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(*mtx);
+        *startSignal = true;
+        cvStart->notify_all();
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    {
+        std::lock_guard<std::mutex> lock(*mtx);
+        for (int val : array) {
+            BOOST_CHECK(val >= 0 && val <= numThreads);
+        }
+        controls[0].terminateSignal = true;
+        controls[0].cvContinue.notify_one();
+    }
+    threads[0].join();
+
+    for (int val : array) {
+        BOOST_CHECK(val != 1);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(*mtx);
+        for (int i = 1; i < numThreads; ++i) {
+            controls[i].terminateSignal = true;
+            controls[i].cvContinue.notify_one();
+        }
+    }
+    for (int i = 1; i < numThreads; ++i) {
         threads[i].join();
     }
-}
\ No newline at end of file
+
+    for (int val : array) {
+        BOOST_CHECK_EQUAL(val, 0);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(JournalKeepsIndicesAcrossChunks) {
+    OwnershipJournal journal;
+    const size_t count = OwnershipJournal::ChunkSize * 2 + 5;
+    for (size_t i = 0; i < count; ++i) {
+        journal.record(i * 3);
+    }
+    BOOST_CHECK_EQUAL(journal.size(), count);
+    BOOST_CHECK(journal.memoryBytes() >= 3 * OwnershipJournal::ChunkSize * sizeof(uint32_t));
+
+    size_t expected = 0;
+    bool inOrder = true;
+    journal.forEach([&](size_t index) {
+        inOrder = inOrder && index == expected * 3;
+        ++expected;
+    });
+    BOOST_CHECK(inOrder);
+    BOOST_CHECK_EQUAL(expected, count);
+
+    journal.clear();
+    BOOST_CHECK_EQUAL(journal.size(), 0u);
+    BOOST_CHECK_EQUAL(journal.memoryBytes(), 0u);
+}
+
+BOOST_FIXTURE_TEST_CASE(CleanupReleasesOnlyJournaledCells, MarkerThreadTestFixture) {
+    array[9] = 1;
+
+    MarkerThread thread(1, array, *mtx, *cvStart, *control, *startSignal, settings);
+    thread.setFixedIndex(0);
+
+    std::thread t([&](){ thread(); });
+
+    {
+        std::lock_guard<std::mutex> lock(*mtx);
+        *startSignal = true;
+        cvStart->notify_all();
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    BOOST_CHECK_EQUAL(array.load(0), 1);
+
+    control->terminateSignal = true;
+    control->continueSignal = true;
+    control->cvContinue.notify_one();
+    t.join();
+
+    BOOST_CHECK_EQUAL(array.load(0), 0);
+    BOOST_CHECK_EQUAL(array.load(9), 1);
+}
+
+BOOST_FIXTURE_TEST_CASE(ByteCellsMarkRenderAndSummarize, MarkerThreadTestFixture) {
+    BasicSharedArray<uint8_t> cells(64);
+    BOOST_CHECK(cells.claim(3, 200));
+    BOOST_CHECK(!cells.claim(3, 1));
+    BOOST_CHECK_EQUAL(cells.load(3), 200);
+    cells.store(3, 0);
+
+    settings.work.kind = WorkKind::None;
+    settings.verbose = false;
+    MarkerThread thread(1, cells, *mtx, *cvStart, *control, *startSignal, settings);
+    std::thread t([&](){ thread(); });
+
+    {
+        std::lock_guard<std::mutex> lock(*mtx);
+        *startSignal = true;
+        cvStart->notify_all();
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(*mtx);
+        BOOST_CHECK(control->cvContinue.wait_for(lock, std::chrono::seconds(1), [&] { return !control->continueSignal.load(); }));
+        OwnershipSummary summary = summarizeOwnership(cells, 1);
+        BOOST_CHECK(summary.owned[0] > 0);
+        BOOST_CHECK_EQUAL(summary.owned[0] + summary.freeCells, cells.size());
+
+        std::ostringstream expected;
+        for (auto& cell : cells) {
+            expected << static_cast<int>(cell.load()) << " ";
+        }
+        expected << std::endl;
+        std::ostringstream rendered;
+        printArray(cells, rendered);
+        BOOST_CHECK(rendered.str() == expected.str());
+    }
+
+    control->terminateSignal = true;
+    control->continueSignal = true;
+    control->cvContinue.notify_one();
+    t.join();
+
+    for (auto& cell : cells) {
+        BOOST_CHECK_EQUAL(cell.load(), 0);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(BitmapAnswersOccupancyQueries) {
+    OccupancyBitmap bitmap(130);
+    BOOST_CHECK_EQUAL(bitmap.freeCells(), 130u);
+    BOOST_CHECK_EQUAL(bitmap.nextFree(0), 0u);
+
+    for (size_t i = 0; i < 129; ++i) {
+        bitmap.set(i);
+    }
+    BOOST_CHECK_EQUAL(bitmap.occupied(), 129u);
+    BOOST_CHECK_EQUAL(bitmap.nextFree(0), 129u);
+    BOOST_CHECK(!bitmap.saturated());
+
+    bitmap.set(129);
+    BOOST_CHECK(bitmap.saturated());
+    BOOST_CHECK_EQUAL(bitmap.nextFree(0), 130u);
+
+    bitmap.reset(70);
+    BOOST_CHECK(!bitmap.test(70));
+    BOOST_CHECK(bitmap.test(71));
+    BOOST_CHECK_EQUAL(bitmap.nextFree(3), 70u);
+    BOOST_CHECK_EQUAL(bitmap.nextFree(71), 130u);
+}
+
+BOOST_FIXTURE_TEST_CASE(BitmapFollowsMarksAndCleanup, MarkerThreadTestFixture) {
+    OccupancyBitmap occupancy(array.size());
+    settings.occupancy = &occupancy;
+    settings.work.kind = WorkKind::None;
+    settings.verbose = false;
+    MarkerThread thread(1, array, *mtx, *cvStart, *control, *startSignal, settings);
+
+    std::thread t([&](){ thread(); });
+
+    {
+        std::lock_guard<std::mutex> lock(*mtx);
+        *startSignal = true;
+        cvStart->notify_all();
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(*mtx);
+        BOOST_CHECK(control->cvContinue.wait_for(lock, std::chrono::seconds(1), [&] { return !control->continueSignal.load(); }));
+        for (size_t i = 0; i < array.size(); ++i) {
+            BOOST_CHECK_EQUAL(occupancy.test(i), array.load(i) != 0);
+        }
+        BOOST_CHECK(occupancy.occupied() > 0);
+    }
+
+    control->terminateSignal = true;
+    control->continueSignal = true;
+    control->cvContinue.notify_one();
+    t.join();
+
+    BOOST_CHECK_EQUAL(occupancy.occupied(), 0u);
+}
+
+BOOST_FIXTURE_TEST_CASE(StaleBitmapBitDoesNotBlockAtomicMarker, MarkerThreadTestFixture) {
+    // Бит ячейки 0 остался от прежнего владельца, а сама ячейка уже свободна
+    OccupancyBitmap occupancy(array.size());
+    occupancy.set(0);
+    settings.occupancy = &occupancy;
+    settings.lockMode = LockMode::Atomic;
+    settings.work.kind = WorkKind::None;
+    settings.verbose = false;
+    MarkerThread thread(1, array, *mtx, *cvStart, *control, *startSignal, settings);
+    thread.setFixedIndex(0);
+
+    std::thread t([&](){ thread(); });
+
+    {
+        std::lock_guard<std::mutex> lock(*mtx);
+        *startSignal = true;
+        cvStart->notify_all();
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(*mtx);
+        BOOST_CHECK(control->cvContinue.wait_for(lock, std::chrono::seconds(1), [&] { return !control->continueSignal.load(); }));
+        BOOST_CHECK_EQUAL(array.load(0), 1);
+    }
+
+    control->terminateSignal = true;
+    control->continueSignal = true;
+    control->cvContinue.notify_one();
+    t.join();
+}
+
+BOOST_AUTO_TEST_CASE(RngIsDeterministicPerSeedAndInRange) {
+    Xoshiro256StarStar a(1), b(1), c(2);
+    bool sameStream = true;
+    bool differentSeedsDiffer = false;
+    for (int i = 0; i < 100; ++i) {
+        uint64_t va = a.next();
+        sameStream = sameStream && va == b.next();
+        differentSeedsDiffer = differentSeedsDiffer || va != c.next();
+    }
+    BOOST_CHECK(sameStream);
+    BOOST_CHECK(differentSeedsDiffer);
+
+    const uint32_t range = 7;
+    std::vector<int> hits(range, 0);
+    IndexBatch batch(3, range);
+    for (int i = 0; i < 7000; ++i) {
+        uint32_t index = batch.next();
+        BOOST_REQUIRE(index < range);
+        ++hits[index];
+    }
+    for (int h : hits) {
+        BOOST_CHECK(h > 800 && h < 1200);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(RngCoversIndicesBeyondRandMax) {
+    Xoshiro256StarStar rng(5);
+    const uint32_t range = 1u << 20;
+    bool sawLargeIndex = false;
+    for (int i = 0; i < 64 && !sawLargeIndex; ++i) {
+        sawLargeIndex = rng.below(range) > 32767u;
+    }
+    BOOST_CHECK(sawLargeIndex);
+}
+
+BOOST_AUTO_TEST_CASE(ScriptedOptionsAreParsed) {
+    const char* argv[] = { "Lab3", "--size", "100", "--threads", "4", "--terminate", "3,1", "--lock", "atomic" };
+    RunOptions options = parseOptions(9, const_cast<char**>(argv));
+    BOOST_CHECK(options.scripted());
+    BOOST_CHECK_EQUAL(options.arraySize, 100);
+    BOOST_CHECK_EQUAL(options.numThreads, 4);
+    BOOST_REQUIRE_EQUAL(options.terminationSchedule.size(), 2u);
+    BOOST_CHECK_EQUAL(options.terminationSchedule[0], 3);
+    BOOST_CHECK_EQUAL(options.terminationSchedule[1], 1);
+    BOOST_CHECK(options.lockMode == LockMode::Atomic);
+
+    const char* missingThreads[] = { "Lab3", "--size", "100" };
+    BOOST_CHECK_THROW(parseOptions(3, const_cast<char**>(missingThreads)), std::invalid_argument);
+
+    const char* outOfRange[] = { "Lab3", "--size", "10", "--threads", "2", "--terminate", "3" };
+    BOOST_CHECK_THROW(parseOptions(7, const_cast<char**>(outOfRange)), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(ScenarioFileFeedsOptions) {
+    const char* path = "scenario_test.txt";
+    {
+        std::ofstream file(path);
+        file << "# perf run\n" << "size 50\n" << "threads 3   # three markers\n" << "\n" << "terminate 2,3,1\n";
+    }
+
+    const char* argv[] = { "Lab3", "--scenario", path };
+    RunOptions options = parseOptions(3, const_cast<char**>(argv));
+    std::remove(path);
+
+    BOOST_CHECK_EQUAL(options.arraySize, 50);
+    BOOST_CHECK_EQUAL(options.numThreads, 3);
+    BOOST_CHECK_EQUAL(options.terminationSchedule.size(), 3u);
+}
+
+BOOST_AUTO_TEST_CASE(MappedArrayLeavesStateInFile) {
+    const char* path = "mapped_test.bin";
+    const char* argv[] = { "Lab3", "--map-file", path };
+    RunOptions options = parseOptions(3, const_cast<char**>(argv));
+    BOOST_CHECK_EQUAL(options.mapFile, path);
+
+    {
+        BasicSharedArray<uint16_t> mapped(1000, options.mapFile);
+        BOOST_REQUIRE(mapped.mapping() != nullptr);
+        BOOST_CHECK_EQUAL(mapped.mapping()->bytes(), 2000u);
+        BOOST_CHECK_EQUAL(mapped.load(999), 0);
+        BOOST_CHECK(mapped.claim(7, 300));
+        mapped.store(999, 5);
+        mapped.mapping()->flush();
+    }
+
+    std::ifstream file(path, std::ios::binary);
+    std::vector<char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    file.close();
+    std::remove(path);
+
+    BOOST_REQUIRE_EQUAL(bytes.size(), 2000u);
+    uint16_t cell7;
+    uint16_t cell999;
+    std::memcpy(&cell7, &bytes[7 * 2], sizeof(cell7));
+    std::memcpy(&cell999, &bytes[999 * 2], sizeof(cell999));
+    BOOST_CHECK_EQUAL(cell7, 300);
+    BOOST_CHECK_EQUAL(cell999, 5);
+
+    BasicSharedArray<uint8_t> heap(10, "");
+    BOOST_CHECK(heap.mapping() == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(PlacedArrayReportsPolicy) {
+    const char* argv[] = { "Lab3", "--numa", "blocks", "--huge-pages", "thp" };
+    RunOptions options = parseOptions(5, const_cast<char**>(argv));
+    BOOST_CHECK(options.numa == NumaPolicy::Blocks);
+    BOOST_CHECK(options.hugePages == HugePages::Transparent);
+
+    const char* withFile[] = { "Lab3", "--numa", "interleave", "--map-file", "x.bin" };
+    BOOST_CHECK_THROW(parseOptions(5, const_cast<char**>(withFile)), std::invalid_argument);
+
+    BOOST_CHECK(!onlineNumaNodes().empty());
+    BasicSharedArray<uint32_t> placed(5000, "", options.numa, options.hugePages);
+    BOOST_REQUIRE(placed.placement() != nullptr);
+    BOOST_CHECK_EQUAL(placed.placement()->bytes() % PlacedBuffer::HugePageBytes, 0u);
+    BOOST_CHECK(placed.placement()->bytes() >= 5000 * sizeof(uint32_t));
+    BOOST_CHECK_EQUAL(std::string(numaPolicyName(placed.placement()->numa())), "blocks");
+    BOOST_CHECK_EQUAL(placed.load(4999), 0);
+    BOOST_CHECK(placed.claim(4999, 3));
+    BOOST_CHECK_EQUAL(placed.load(4999), 3);
+
+    BasicSharedArray<uint32_t> plain(10, "");
+    BOOST_CHECK(plain.placement() == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(NumaMaskFollowsSparseNodeIds) {
+    // Узел 1 выключен: маска не должна его включать
+    std::vector<int> nodes = parseNodeList("0,2-3");
+    std::vector<int> expected = { 0, 2, 3 };
+    BOOST_CHECK_EQUAL_COLLECTIONS(nodes.begin(), nodes.end(), expected.begin(), expected.end());
+    BOOST_CHECK_EQUAL(numaNodeMask(nodes), 0b1101ul);
+
+    // Номера за пределами маски пропускаются, испорченный список пуст
+    BOOST_CHECK_EQUAL(numaNodeMask(parseNodeList("1,70")), 0b10ul);
+    BOOST_CHECK(parseNodeList("x-1").empty());
+}
+
+BOOST_AUTO_TEST_CASE(PinOrderFollowsTopology) {
+    // Два сокета по два ядра, у каждого ядра два SMT-потока
+    std::vector<CpuInfo> topology;
+    for (int cpu = 0; cpu < 8; ++cpu) {
+        topology.push_back({ cpu, (cpu % 4) / 2, cpu / 4 });
+    }
+    std::vector<int> compact = pinOrder(topology, PinPolicy::Compact);
+    BOOST_CHECK((compact == std::vector<int>{ 0, 1, 2, 3, 4, 5, 6, 7 }));
+    std::vector<int> scatter = pinOrder(topology, PinPolicy::Scatter);
+    BOOST_CHECK((scatter == std::vector<int>{ 0, 4, 2, 6, 1, 5, 3, 7 }));
+
+    BOOST_CHECK((parseCpuList("0,2,4-6") == std::vector<int>{ 0, 2, 4, 5, 6 }));
+    BOOST_CHECK_THROW(parseCpuList("3-1"), std::invalid_argument);
+    BOOST_CHECK_THROW(parseCpuList("x"), std::invalid_argument);
+
+    const char* argv[] = { "Lab3", "--pin", "1,3" };
+    RunOptions options = parseOptions(3, const_cast<char**>(argv));
+    BOOST_CHECK(options.pinPolicy == PinPolicy::List);
+    BOOST_CHECK_EQUAL(options.pinCpus.size(), 2u);
+
+    std::vector<CpuInfo> local = readCpuTopology();
+    BOOST_REQUIRE(!local.empty());
+    std::atomic<bool> done(false);
+    std::thread worker([&] { while (!done.load()) { std::this_thread::yield(); } });
+    BOOST_CHECK(pinThread(worker, local[0].cpu));
+    done = true;
+    worker.join();
+}
+
+BOOST_AUTO_TEST_CASE(WorkModelSpinTakesRequestedTime) {
+    WorkModel work;
+    work.kind = WorkKind::Spin;
+    work.duration = std::chrono::milliseconds(20);
+
+    auto start = std::chrono::steady_clock::now();
+    work.perform();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    BOOST_CHECK(elapsed >= std::chrono::milliseconds(5));
+    BOOST_CHECK(elapsed < std::chrono::milliseconds(500));
+
+    BOOST_CHECK_EQUAL(WorkModel::hash(64), WorkModel::hash(64));
+}
+
+BOOST_FIXTURE_TEST_CASE(NoDelayWorkFillsArrayQuickly, MarkerThreadTestFixture) {
+    settings.work.kind = WorkKind::None;
+    MarkerThread thread(1, array, *mtx, *cvStart, *control, *startSignal, settings);
+
+    std::thread t([&](){ thread(); });
+
+    {
+        std::lock_guard<std::mutex> lock(*mtx);
+        *startSignal = true;
+        cvStart->notify_all();
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(*mtx);
+        BOOST_CHECK(control->cvContinue.wait_for(lock, std::chrono::seconds(1), [&] { return !control->continueSignal.load(); }));
+    }
+
+    control->terminateSignal = true;
+    control->continueSignal = true;
+    control->cvContinue.notify_one();
+    t.join();
+}
+
+BOOST_FIXTURE_TEST_CASE(BarrierRoundsDrainAllMarkers, MarkerThreadTestFixture) {
+    const int numThreads = 3;
+    std::vector<MarkerControl> controls(numThreads);
+    RoundBarrier barrier(*mtx, controls);
+    settings.barrier = &barrier;
+    settings.work.kind = WorkKind::None;
+    settings.verbose = false;
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < numThreads; ++i) {
+        threads.emplace_back(MarkerThread(i + 1, array, *mtx, *cvStart, controls[i], *startSignal, settings));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(*mtx);
+        *startSignal = true;
+        cvStart->notify_all();
+    }
+
+    for (int victim = 1; victim <= numThreads; ++victim) {
+        barrier.waitAllBlocked();
+        barrier.terminate(controls[victim - 1]);
+        threads[victim - 1].join();
+
+        for (int val : array) {
+            BOOST_CHECK(val != victim);
+        }
+        if (victim < numThreads) {
+            barrier.resume();
+        }
+    }
+
+    for (int val : array) {
+        BOOST_CHECK_EQUAL(val, 0);
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(BarrierTerminationWakesOnlyTheVictim, MarkerThreadTestFixture) {
+    const int numThreads = 8;
+    std::vector<MarkerControl> controls(numThreads);
+    RoundBarrier barrier(*mtx, controls);
+    settings.barrier = &barrier;
+    settings.work.kind = WorkKind::None;
+    settings.verbose = false;
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < numThreads; ++i) {
+        threads.emplace_back(MarkerThread(i + 1, array, *mtx, *cvStart, controls[i], *startSignal, settings));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(*mtx);
+        *startSignal = true;
+        cvStart->notify_all();
+    }
+
+    for (int victim = 1; victim <= numThreads; ++victim) {
+        barrier.waitAllBlocked();
+
+        // Завершение будит только жертву, остальные продолжают спать
+        long long before = barrier.wakeups();
+        barrier.terminate(controls[victim - 1]);
+        threads[victim - 1].join();
+        BOOST_CHECK_EQUAL(barrier.wakeups() - before, 1);
+
+        // Продолжение будит каждого оставшегося по одному разу
+        if (victim < numThreads) {
+            before = barrier.wakeups();
+            barrier.resume();
+            barrier.waitAllBlocked();
+            BOOST_CHECK_EQUAL(barrier.wakeups() - before, numThreads - victim);
+        }
+    }
+}
+
+namespace {
+    class CountingTask : public PoolTask {
+    public:
+        CountingTask(std::atomic<int>& runs, int delayed) : runs_(runs), delayed_(delayed) {}
+
+        void run(TaskPool& pool) override {
+            runs_.fetch_add(1);
+            if (delayed_-- > 0) {
+                pool.submitAfter(this, std::chrono::microseconds(200));
+            }
+        }
+
+    private:
+        std::atomic<int>& runs_;
+        int delayed_;
+    };
+}
+
+BOOST_AUTO_TEST_CASE(PoolRunsTasksAndTimers) {
+    std::atomic<int> runs(0);
+    std::vector<std::unique_ptr<CountingTask>> tasks;
+    for (int i = 0; i < 100; ++i) {
+        tasks.emplace_back(new CountingTask(runs, 3));
+    }
+
+    TaskPool pool(3);
+    BOOST_CHECK_EQUAL(pool.workers(), 3u);
+    for (auto& task : tasks) {
+        pool.submit(task.get());
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (runs.load() < 400 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    BOOST_CHECK_EQUAL(runs.load(), 400);
+}
+
+BOOST_FIXTURE_TEST_CASE(PooledMarkersDrainRoundByRound, MarkerThreadTestFixture) {
+    const int numMarkers = 50;
+    BasicSharedArray<uint8_t> cells(200);
+    OccupancyBitmap occupancy(cells.size());
+    CounterBoard counters(numMarkers);
+    settings.lockMode = LockMode::Atomic;
+    settings.work.duration = std::chrono::microseconds(100);
+    settings.occupancy = &occupancy;
+    settings.counters = &counters;
+    settings.verbose = false;
+
+    std::vector<MarkerControl> controls(numMarkers);
+    MarkerRoster roster(numMarkers);
+    std::vector<std::unique_ptr<MarkerTask<uint8_t>>> tasks;
+    for (int i = 0; i < numMarkers; ++i) {
+        tasks.emplace_back(new MarkerTask<uint8_t>(i + 1, cells, controls[i], roster, settings));
+    }
+
+    TaskPool pool(4);
+    for (auto& task : tasks) {
+        pool.submit(task.get());
+    }
+
+    for (int victim = numMarkers; victim >= 1; --victim) {
+        roster.waitAllParked();
+        for (int i = 0; i < victim; ++i) {
+            BOOST_CHECK(!controls[i].continueSignal.load());
+        }
+
+        controls[victim - 1].terminateSignal = true;
+        roster.unparkOne();
+        pool.submit(tasks[victim - 1].get());
+        roster.waitAllParked();
+        BOOST_CHECK_EQUAL(roster.live(), victim - 1);
+        BOOST_CHECK_EQUAL(counters.forMarker(victim).marked.load(), counters.forMarker(victim).released.load());
+        for (auto& cell : cells) {
+            BOOST_CHECK(cell.load() != victim);
+        }
+
+        roster.unparkAll();
+        for (int i = 0; i < victim - 1; ++i) {
+            controls[i].continueSignal = true;
+            pool.submit(tasks[i].get());
+        }
+    }
+
+    BOOST_CHECK_EQUAL(occupancy.occupied(), 0u);
+    BOOST_CHECK_EQUAL(counters.totals().held(), 0);
+
+    const char* lockedPool[] = { "Lab3", "--scheduler", "pool" };
+    BOOST_CHECK_THROW(parseOptions(3, const_cast<char**>(lockedPool)), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(DetectorFindsCyclesAsMarkersBlock) {
+    std::mutex mtx;
+    std::unique_lock<std::mutex> lock(mtx);
+    DeadlockDetector detector(4);
+
+    // Цепочка 1 -> 2 -> 3 ещё не цикл
+    BOOST_CHECK(detector.block(1, 2));
+    BOOST_CHECK(detector.block(2, 3));
+    BOOST_CHECK_EQUAL(detector.detected(), 0);
+    // Освободившаяся клетка ждать не заставляет
+    BOOST_CHECK(!detector.block(4, 0));
+
+    BOOST_CHECK(detector.block(3, 1));
+    BOOST_CHECK_EQUAL(detector.detected(), 1);
+    DeadlockCycle cycle = detector.waitForCycle(lock);
+    BOOST_CHECK((cycle.members == std::vector<int>{ 3, 1, 2 }));
+
+    CounterBoard counters(4);
+    counters.forMarker(1).marked = 5;
+    counters.forMarker(2).marked = 1;
+    counters.forMarker(3).marked = 7;
+    BOOST_CHECK_EQUAL(chooseVictim(cycle, VictimCost::FewestMarks, counters), 2);
+    BOOST_CHECK_EQUAL(chooseVictim(cycle, VictimCost::Youngest, counters), 3);
+
+    BOOST_CHECK((detector.remove(2) == std::vector<int>{ 1 }));
+
+    // Маркер, упёршийся в свою же клетку, — цикл из одного
+    BOOST_CHECK(detector.block(4, 4));
+    BOOST_CHECK((detector.waitForCycle(lock).members == std::vector<int>{ 4 }));
+}
+
+BOOST_FIXTURE_TEST_CASE(DetectedDeadlocksDrainAllMarkers, MarkerThreadTestFixture) {
+    const int numThreads = 8;
+    SharedArray cells(40);
+    DeadlockDetector detector(numThreads);
+    CounterBoard counters(numThreads);
+    settings.lockMode = LockMode::Atomic;
+    settings.work.kind = WorkKind::None;
+    settings.counters = &counters;
+    settings.deadlocks = &detector;
+    settings.verbose = false;
+    std::vector<MarkerControl> controls(numThreads);
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < numThreads; ++i) {
+        threads.emplace_back(MarkerThread(i + 1, cells, *mtx, *cvStart, controls[i], *startSignal, settings));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(*mtx);
+        *startSignal = true;
+        cvStart->notify_all();
+    }
+
+    for (int round = 0; round < numThreads; ++round) {
+        std::unique_lock<std::mutex> lock(*mtx);
+        DeadlockCycle cycle = detector.waitForCycle(lock);
+        int victim = chooseVictim(cycle, VictimCost::FewestMarks, counters);
+        BOOST_CHECK(!controls[victim - 1].terminateSignal.load());
+        controls[victim - 1].terminateSignal = true;
+        controls[victim - 1].cvContinue.notify_one();
+        lock.unlock();
+        threads[victim - 1].join();
+
+        lock.lock();
+        for (auto& cell : cells) {
+            BOOST_CHECK(static_cast<int>(cell.load()) != victim);
+        }
+        for (int waiter : detector.remove(victim)) {
+            controls[waiter - 1].continueSignal = true;
+            controls[waiter - 1].cvContinue.notify_one();
+        }
+    }
+
+    BOOST_CHECK_EQUAL(detector.detected(), numThreads);
+    BOOST_CHECK_EQUAL(counters.totals().held(), 0);
+    for (auto& cell : cells) {
+        BOOST_CHECK_EQUAL(cell.load(), 0);
+    }
+
+    const char* withSchedule[] = { "Lab3", "--detect", "fewest", "--terminate", "1" };
+    BOOST_CHECK_THROW(parseOptions(5, const_cast<char**>(withSchedule)), std::invalid_argument);
+}
+
+BOOST_FIXTURE_TEST_CASE(MultiCellClaimsAreAllOrNothing, MarkerThreadTestFixture) {
+    const int numThreads = 4;
+    const int claimCells = 3;
+    const LockMode modes[] = { LockMode::Global, LockMode::Striped, LockMode::Atomic };
+    for (LockMode mode : modes) {
+        SharedArray cells(60);
+        StripedLocks stripes(cells.size(), 8);
+        CounterBoard counters(numThreads);
+        std::atomic<bool> started(false);
+        settings.lockMode = mode;
+        settings.stripes = &stripes;
+        settings.work.kind = WorkKind::None;
+        settings.counters = &counters;
+        settings.claimCells = claimCells;
+        settings.verbose = false;
+        std::vector<MarkerControl> controls(numThreads);
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < numThreads; ++i) {
+            threads.emplace_back(MarkerThread(i + 1, cells, *mtx, *cvStart, controls[i], started, settings));
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(*mtx);
+            started = true;
+            cvStart->notify_all();
+        }
+
+        // Когда все заблокированы, у каждого только целые наборы по claimCells клеток
+        for (int i = 0; i < numThreads; ++i) {
+            std::unique_lock<std::mutex> lock(*mtx);
+            controls[i].cvContinue.wait(lock, [&] { return !controls[i].continueSignal.load(); });
+        }
+        for (int id = 1; id <= numThreads; ++id) {
+            long long owned = std::count_if(cells.begin(), cells.end(), [id](int val) { return val == id; });
+            BOOST_CHECK_EQUAL(owned, counters.forMarker(id).marked.load());
+            BOOST_CHECK_EQUAL(owned % claimCells, 0);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(*mtx);
+            for (auto& control : controls) {
+                control.terminateSignal = true;
+                control.cvContinue.notify_one();
+            }
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        for (int val : cells) {
+            BOOST_CHECK_EQUAL(val, 0);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(VictimPoliciesPickAmongLiveMarkers) {
+    std::vector<MarkerControl> controls(4);
+    CounterBoard counters(4);
+    const long long marks[] = { 3, 9, 1, 9 };
+    const long long blockedAt[] = { 40, 10, 30, 20 };
+    for (int id = 1; id <= 4; ++id) {
+        counters.forMarker(id).marked = marks[id - 1];
+        counters.forMarker(id).blockedAt = blockedAt[id - 1];
+    }
+
+    BOOST_CHECK_EQUAL(VictimPicker(VictimPolicy::MostMarks, 1).next(controls, counters), 2);
+    BOOST_CHECK_EQUAL(VictimPicker(VictimPolicy::FewestMarks, 1).next(controls, counters), 3);
+    BOOST_CHECK_EQUAL(VictimPicker(VictimPolicy::OldestBlocked, 1).next(controls, counters), 2);
+
+    // Завершённые потоки не выбираются
+    controls[1].terminateSignal = true;
+    BOOST_CHECK_EQUAL(VictimPicker(VictimPolicy::MostMarks, 1).next(controls, counters), 4);
+    BOOST_CHECK_EQUAL(VictimPicker(VictimPolicy::OldestBlocked, 1).next(controls, counters), 4);
+
+    // Round-robin идёт по кругу от предыдущей жертвы
+    VictimPicker roundRobin(VictimPolicy::RoundRobin, 1);
+    BOOST_CHECK_EQUAL(roundRobin.next(controls, counters), 1);
+    BOOST_CHECK_EQUAL(roundRobin.next(controls, counters), 3);
+    controls[3].terminateSignal = true;
+    BOOST_CHECK_EQUAL(roundRobin.next(controls, counters), 1);
+
+    // Одинаковое зерно — одинаковая последовательность
+    VictimPicker first(VictimPolicy::Random, 42);
+    VictimPicker second(VictimPolicy::Random, 42);
+    for (int i = 0; i < 10; ++i) {
+        int victim = first.next(controls, counters);
+        BOOST_CHECK(victim == 1 || victim == 3);
+        BOOST_CHECK_EQUAL(victim, second.next(controls, counters));
+    }
+
+    for (auto& control : controls) {
+        control.terminateSignal = true;
+    }
+    BOOST_CHECK_EQUAL(roundRobin.next(controls, counters), 0);
+
+    const char* seeded[] = { "Lab3", "--victim", "random:42" };
+    RunOptions options = parseOptions(3, const_cast<char**>(seeded));
+    BOOST_CHECK(options.victimPolicy == VictimPolicy::Random);
+    BOOST_CHECK_EQUAL(options.victimSeed, 42u);
+    const char* badSeed[] = { "Lab3", "--victim", "most:3" };
+    BOOST_CHECK_THROW(parseOptions(3, const_cast<char**>(badSeed)), std::invalid_argument);
+    const char* withSchedule[] = { "Lab3", "--victim", "oldest", "--terminate", "1" };
+    BOOST_CHECK_THROW(parseOptions(5, const_cast<char**>(withSchedule)), std::invalid_argument);
+}
+
+BOOST_FIXTURE_TEST_CASE(MetricsExportCountersAndRounds, MarkerThreadTestFixture) {
+    const int numThreads = 2;
+    CounterBoard counters(numThreads);
+    settings.work.kind = WorkKind::None;
+    settings.counters = &counters;
+    settings.timeWaits = true;
+    settings.verbose = false;
+    std::vector<MarkerControl> controls(numThreads);
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < numThreads; ++i) {
+        threads.emplace_back(MarkerThread(i + 1, array, *mtx, *cvStart, controls[i], *startSignal, settings));
+    }
+    {
+        std::lock_guard<std::mutex> lock(*mtx);
+        *startSignal = true;
+        cvStart->notify_all();
+    }
+    for (int i = 0; i < numThreads; ++i) {
+        std::unique_lock<std::mutex> lock(*mtx);
+        controls[i].cvContinue.wait(lock, [&] { return !controls[i].continueSignal.load(); });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    {
+        std::lock_guard<std::mutex> lock(*mtx);
+        for (auto& control : controls) {
+            control.terminateSignal = true;
+            control.cvContinue.notify_one();
+        }
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    // Ожидание продолжения попало в счётчик
+    BOOST_CHECK(counters.forMarker(1).condWaitNs.load() >= 5000000);
+
+    RunMetrics metrics(counters);
+    RoundTiming round;
+    round.victim = 2;
+    round.waitMs = 1.5;
+    metrics.addRound(round);
+
+    std::ostringstream json;
+    writeMetricsJson(metrics, json);
+    BOOST_CHECK(json.str().find("\"final\": false") != std::string::npos);
+    BOOST_CHECK(json.str().find("{\"id\": 2, \"marks\": " + std::to_string(counters.forMarker(2).marked.load())) != std::string::npos);
+    BOOST_CHECK(json.str().find("{\"round\": 1, \"victim\": 2, \"wait_ms\": 1.5") != std::string::npos);
+
+    std::ostringstream prometheus;
+    writeMetricsPrometheus(metrics, prometheus);
+    BOOST_CHECK(prometheus.str().find("# TYPE lab3_marker_blocks_total counter\n") != std::string::npos);
+    BOOST_CHECK(prometheus.str().find("lab3_marker_releases_total{marker=\"1\"} " + std::to_string(counters.forMarker(1).released.load())) != std::string::npos);
+    BOOST_CHECK(prometheus.str().find("lab3_rounds_total 1\n") != std::string::npos);
+
+    // Периодический экспорт и итоговый снимок через временный файл
+    const char* path = "metrics_test.prom";
+    {
+        MetricsExporter exporter(metrics, MetricsFormat::Prometheus, path, std::chrono::milliseconds(1));
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        exporter.finish();
+    }
+    std::ifstream file(path);
+    std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    file.close();
+    std::remove(path);
+    BOOST_CHECK(text.find("lab3_run_finished 1\n") != std::string::npos);
+    BOOST_CHECK(!std::ifstream(std::string(path) + ".tmp"));
+
+    const char* argv[] = { "Lab3", "--metrics-file", "m.json", "--metrics-format", "prometheus", "--metrics-interval-ms", "250" };
+    RunOptions options = parseOptions(7, const_cast<char**>(argv));
+    BOOST_CHECK(options.metricsFormat == MetricsFormat::Prometheus);
+    BOOST_CHECK_EQUAL(options.metricsInterval.count(), 250);
+}
+
+BOOST_AUTO_TEST_CASE(ProfiledMutexMeasuresWaitHoldAndHandoffs) {
+    LatencyHistogram histogram;
+    histogram.record(0);
+    histogram.record(100);
+    histogram.record(1000);
+    histogram.record(1000000);
+    BOOST_CHECK_EQUAL(histogram.count(), 4);
+    BOOST_CHECK_EQUAL(histogram.totalNs(), 1001100);
+    BOOST_CHECK_EQUAL(histogram.percentileNs(0.5), 1024);
+    BOOST_CHECK_EQUAL(histogram.percentileNs(0.99), 1000000);
+
+    ProfiledMutex mutex;
+    std::condition_variable_any cv;
+    bool ready = false;
+
+    // Второй поток ждёт, пока первый держит мьютекс 20 мс
+    std::unique_lock<ProfiledMutex> lock(mutex);
+    std::thread waiter([&] {
+        std::unique_lock<ProfiledMutex> waiterLock(mutex);
+        ready = true;
+        cv.notify_one();
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    cv.wait(lock, [&] { return ready; });
+    lock.unlock();
+    waiter.join();
+
+    BOOST_CHECK(mutex.waits().count() >= 3);
+    BOOST_CHECK_EQUAL(mutex.waits().count(), mutex.holds().count());
+    BOOST_CHECK(mutex.contended() >= 1);
+    BOOST_CHECK(mutex.handoffs() >= 2);
+    BOOST_CHECK(mutex.holds().maxNs() >= 20000000);
+    BOOST_CHECK(mutex.waits().maxNs() >= 10000000);
+
+    std::ostringstream report;
+    mutex.report(report);
+    BOOST_CHECK(report.str().find("lock_profile acquisitions=") == 0);
+}
+
+#if defined(__cpp_impl_coroutine)
+// Собирается только в C++20-цели MarkerCoroutineTest
+BOOST_AUTO_TEST_CASE(CoroutineMarkersDrainRoundByRound) {
+    const int numMarkers = 20;
+    BasicSharedArray<uint8_t> cells(100);
+    OccupancyBitmap occupancy(cells.size());
+    CounterBoard counters(numMarkers);
+    MarkerSettings settings;
+    settings.lockMode = LockMode::Atomic;
+    settings.work.duration = std::chrono::microseconds(100);
+    settings.occupancy = &occupancy;
+    settings.counters = &counters;
+    settings.verbose = false;
+
+    CoroutineLoop loop;
+    StartGate start(loop);
+    std::vector<RoundSlot> slots(numMarkers);
+    std::vector<MarkerCoroutine> markers;
+    for (int i = 0; i < numMarkers; ++i) {
+        markers.push_back(runMarkerCoroutine(i + 1, cells, loop, start, slots[i], settings));
+    }
+
+    // До сигнала старта никто ничего не отмечает
+    loop.runUntilIdle();
+    BOOST_CHECK_EQUAL(occupancy.occupied(), 0u);
+    start.open();
+
+    for (int victim = numMarkers; victim >= 1; --victim) {
+        loop.runUntilIdle();
+        for (int i = 0; i < victim; ++i) {
+            BOOST_CHECK(slots[i].parked());
+        }
+
+        slots[victim - 1].terminate = true;
+        loop.resume(slots[victim - 1].waiting);
+        BOOST_CHECK(markers[victim - 1].done());
+        BOOST_CHECK(slots[victim - 1].finished);
+        BOOST_CHECK_EQUAL(counters.forMarker(victim).marked.load(), counters.forMarker(victim).released.load());
+        for (auto& cell : cells) {
+            BOOST_CHECK(cell.load() != victim);
+        }
+
+        for (auto& slot : slots) {
+            if (slot.parked()) {
+                loop.resume(slot.waiting);
+            }
+        }
+    }
+
+    BOOST_CHECK_EQUAL(occupancy.occupied(), 0u);
+    BOOST_CHECK_EQUAL(counters.totals().held(), 0);
+    BOOST_CHECK(loop.switches() > 0);
+
+    const char* coroutine[] = { "Lab3", "--scheduler", "coroutine", "--lock", "atomic" };
+    BOOST_CHECK(parseOptions(5, const_cast<char**>(coroutine)).scheduler == SchedulerKind::Coroutine);
+    const char* lockedCoroutine[] = { "Lab3", "--scheduler", "coroutine" };
+    BOOST_CHECK_THROW(parseOptions(3, const_cast<char**>(lockedCoroutine)), std::invalid_argument);
+}
+#else
+BOOST_AUTO_TEST_CASE(CoroutineSchedulerNeedsCpp20Build) {
+    const char* coroutine[] = { "Lab3", "--scheduler", "coroutine", "--lock", "atomic" };
+    BOOST_CHECK_THROW(parseOptions(5, const_cast<char**>(coroutine)), std::invalid_argument);
+}
+#endif
+
+BOOST_AUTO_TEST_CASE(RendererMatchesClassicFormat) {
+    SharedArray big(ArrayRenderer::ChunkCells * 3 + 7);
+    for (size_t i = 0; i < big.size(); ++i) {
+        big.store(i, static_cast<int>(i % 13) * (i % 2 == 0 ? 1 : 1000));
+    }
+
+    std::ostringstream expected;
+    for (int num : big) {
+        expected << num << " ";
+    }
+    expected << std::endl;
+
+    ArrayRenderer renderer(4);
+    std::ostringstream rendered;
+    renderer.render(big, rendered);
+    BOOST_CHECK(rendered.str() == expected.str());
+
+    SharedArray small(3);
+    small.store(1, 42);
+    std::ostringstream smallOut;
+    renderer.render(small, smallOut);
+    BOOST_CHECK_EQUAL(smallOut.str(), "0 42 0 \n");
+}
+
+BOOST_AUTO_TEST_CASE(SummaryCountsOwnersAndFreeCells) {
+    SharedArray cells(11);
+    int values[] = { 0, 1, 2, 2, 0, 3, 3, 3, 0, 1, 7 };
+    for (size_t i = 0; i < cells.size(); ++i) {
+        cells.store(i, values[i]);
+    }
+
+    OwnershipSummary summary = summarizeOwnership(cells, 3);
+    BOOST_CHECK_EQUAL(summary.total, 11u);
+    BOOST_CHECK_EQUAL(summary.freeCells, 3u);
+    BOOST_REQUIRE_EQUAL(summary.owned.size(), 3u);
+    BOOST_CHECK_EQUAL(summary.owned[0], 2u);
+    BOOST_CHECK_EQUAL(summary.owned[1], 2u);
+    BOOST_CHECK_EQUAL(summary.owned[2], 3u);
+    BOOST_CHECK_CLOSE(summary.fillRatio(), 8.0 / 11.0, 1e-9);
+}
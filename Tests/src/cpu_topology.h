@@ -0,0 +1,207 @@
+#pragma once
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+enum class PinPolicy
+{
+    None,
+    Compact,
+    Scatter,
+    List
+};
+
+inline const char* pinPolicyName(PinPolicy policy)
+{
+    switch (policy)
+    {
+    case PinPolicy::Compact:
+        return "compact";
+    case PinPolicy::Scatter:
+        return "scatter";
+    case PinPolicy::List:
+        return "list";
+    default:
+        return "none";
+    }
+}
+
+struct CpuInfo
+{
+    int cpu;
+    int core;
+    int package;
+};
+
+inline int parseCpuNumber(const std::string& list, const std::string& text)
+{
+    size_t consumed = 0;
+    int value = -1;
+    try
+    {
+        value = std::stoi(text, &consumed);
+    }
+    catch (const std::exception&)
+    {
+        consumed = 0;
+    }
+
+    if (consumed == 0 || consumed != text.size() || value < 0)
+    {
+        throw std::invalid_argument("Bad CPU list '" + list + "', expected e.g. 0,2,4-7.");
+    }
+    return value;
+}
+
+// "0-3,8,10-11" into the individual numbers, in the order given.
+inline std::vector<int> parseCpuList(const std::string& list)
+{
+    std::vector<int> cpus;
+    std::stringstream ranges(list);
+    std::string range;
+    while (std::getline(ranges, range, ','))
+    {
+        size_t dash = range.find('-');
+        int first = parseCpuNumber(list, range.substr(0, dash));
+        int last = dash == std::string::npos ? first : parseCpuNumber(list, range.substr(dash + 1));
+        if (last < first)
+        {
+            throw std::invalid_argument("Bad CPU list '" + list + "', expected e.g. 0,2,4-7.");
+        }
+        for (int cpu = first; cpu <= last; ++cpu)
+        {
+            cpus.push_back(cpu);
+        }
+    }
+    if (cpus.empty())
+    {
+        throw std::invalid_argument("Bad CPU list '" + list + "', expected e.g. 0,2,4-7.");
+    }
+    return cpus;
+}
+
+inline int readSysInt(const std::string& path, int fallback)
+{
+    std::ifstream file(path);
+    int value;
+    return file >> value ? value : fallback;
+}
+
+// Online CPUs with their core and package ids from /sys/devices/system/cpu. Without
+// /sys every hardware thread counts as its own core on package 0.
+inline std::vector<CpuInfo> readCpuTopology()
+{
+    std::vector<CpuInfo> topology;
+    std::ifstream online("/sys/devices/system/cpu/online");
+    std::string list;
+    if (online >> list)
+    {
+        for (int cpu : parseCpuList(list))
+        {
+            std::string base = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/";
+            topology.push_back({ cpu, readSysInt(base + "core_id", cpu), readSysInt(base + "physical_package_id", 0) });
+        }
+        return topology;
+    }
+
+    unsigned count = std::thread::hardware_concurrency();
+    for (unsigned cpu = 0; cpu < (count == 0 ? 1 : count); ++cpu)
+    {
+        topology.push_back({ static_cast<int>(cpu), static_cast<int>(cpu), 0 });
+    }
+    return topology;
+}
+
+// The CPU sequence markers are assigned from, marker i taking entry i modulo its length.
+// Compact keeps SMT siblings, then cores, then packages together; scatter takes one
+// thread per core, alternating packages, before it comes back for the siblings.
+inline std::vector<int> pinOrder(const std::vector<CpuInfo>& topology, PinPolicy policy)
+{
+    struct Slot
+    {
+        CpuInfo info;
+        int sibling;
+        int coreRank;
+    };
+
+    std::vector<CpuInfo> sorted(topology);
+    std::sort(sorted.begin(), sorted.end(), [](const CpuInfo& a, const CpuInfo& b)
+    {
+        if (a.package != b.package)
+        {
+            return a.package < b.package;
+        }
+        return a.core != b.core ? a.core < b.core : a.cpu < b.cpu;
+    });
+
+    std::vector<int> order;
+    if (policy == PinPolicy::Compact)
+    {
+        for (const auto& info : sorted)
+        {
+            order.push_back(info.cpu);
+        }
+        return order;
+    }
+
+    std::vector<Slot> slots;
+    for (size_t i = 0; i < sorted.size(); ++i)
+    {
+        Slot slot = { sorted[i], 0, 0 };
+        if (i > 0 && sorted[i - 1].package == slot.info.package)
+        {
+            const Slot& previous = slots.back();
+            bool sameCore = previous.info.core == slot.info.core;
+            slot.sibling = sameCore ? previous.sibling + 1 : 0;
+            slot.coreRank = sameCore ? previous.coreRank : previous.coreRank + 1;
+        }
+        slots.push_back(slot);
+    }
+    std::stable_sort(slots.begin(), slots.end(), [](const Slot& a, const Slot& b)
+    {
+        if (a.sibling != b.sibling)
+        {
+            return a.sibling < b.sibling;
+        }
+        return a.coreRank != b.coreRank ? a.coreRank < b.coreRank : a.info.package < b.info.package;
+    });
+    for (const auto& slot : slots)
+    {
+        order.push_back(slot.info.cpu);
+    }
+    return order;
+}
+
+// Restricts a thread to one CPU; false when the OS refuses (e.g. CPU not allowed).
+inline bool pinThread(std::thread& thread, int cpu)
+{
+#ifdef _WIN32
+    if (cpu >= static_cast<int>(sizeof(DWORD_PTR) * 8))
+    {
+        return false;
+    }
+    return SetThreadAffinityMask(thread.native_handle(), static_cast<DWORD_PTR>(1) << cpu) != 0;
+#else
+    if (cpu >= CPU_SETSIZE)
+    {
+        return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set) == 0;
+#endif
+}
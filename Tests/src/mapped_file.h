@@ -0,0 +1,198 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// A file truncated to `bytes` zeroes and mapped shared into the process, so the array
+// can outgrow RAM and its last state stays in the file after the run.
+class MappedFile
+{
+public:
+    MappedFile(const std::string& path, size_t bytes)
+        : path_(path), bytes_(bytes)
+    {
+#ifdef _WIN32
+        file_ = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file_ == INVALID_HANDLE_VALUE)
+        {
+            throw std::invalid_argument("Cannot create map file '" + path + "'.");
+        }
+        ULARGE_INTEGER size;
+        size.QuadPart = bytes;
+        mapping_ = CreateFileMappingA(file_, NULL, PAGE_READWRITE, size.HighPart, size.LowPart, NULL);
+        data_ = mapping_ != NULL ? MapViewOfFile(mapping_, FILE_MAP_ALL_ACCESS, 0, 0, bytes) : NULL;
+        if (data_ == NULL)
+        {
+            close();
+            throw std::invalid_argument("Cannot map file '" + path + "'.");
+        }
+#else
+        fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd_ < 0)
+        {
+            throw std::invalid_argument("Cannot create map file '" + path + "'.");
+        }
+        if (::ftruncate(fd_, static_cast<off_t>(bytes)) != 0)
+        {
+            close();
+            throw std::invalid_argument("Cannot grow map file '" + path + "' to " + std::to_string(bytes) + " bytes.");
+        }
+        data_ = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+        if (data_ == MAP_FAILED)
+        {
+            data_ = nullptr;
+            close();
+            throw std::invalid_argument("Cannot map file '" + path + "'.");
+        }
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile()
+    {
+        close();
+    }
+
+    void* data() const
+    {
+        return data_;
+    }
+
+    size_t bytes() const
+    {
+        return bytes_;
+    }
+
+    const std::string& path() const
+    {
+        return path_;
+    }
+
+    // Writes dirty pages back and waits for it; returns how long that took.
+    double flush()
+    {
+        auto start = std::chrono::steady_clock::now();
+#ifdef _WIN32
+        FlushViewOfFile(data_, 0);
+        FlushFileBuffers(file_);
+#else
+        ::msync(data_, bytes_, MS_SYNC);
+#endif
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count();
+    }
+
+private:
+    void close()
+    {
+#ifdef _WIN32
+        if (data_ != NULL)
+        {
+            UnmapViewOfFile(data_);
+        }
+        if (mapping_ != NULL)
+        {
+            CloseHandle(mapping_);
+        }
+        if (file_ != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(file_);
+        }
+        data_ = NULL;
+        mapping_ = NULL;
+        file_ = INVALID_HANDLE_VALUE;
+#else
+        if (data_ != nullptr)
+        {
+            ::munmap(data_, bytes_);
+        }
+        if (fd_ >= 0)
+        {
+            ::close(fd_);
+        }
+        data_ = nullptr;
+        fd_ = -1;
+#endif
+    }
+
+    std::string path_;
+    size_t bytes_;
+    void* data_ = nullptr;
+#ifdef _WIN32
+    HANDLE file_ = INVALID_HANDLE_VALUE;
+    HANDLE mapping_ = NULL;
+#else
+    int fd_ = -1;
+#endif
+};
+
+// Process-wide paging and write counters; the run reports the difference between two
+// samples. Windows does not split faults into minor and major, so all of them count as minor.
+struct PagingSample
+{
+    long long minorFaults = 0;
+    long long majorFaults = 0;
+    long long writtenBytes = 0;
+
+    static PagingSample now()
+    {
+        PagingSample sample;
+#ifdef _WIN32
+        PROCESS_MEMORY_COUNTERS memory;
+        if (K32GetProcessMemoryInfo(GetCurrentProcess(), &memory, sizeof(memory)))
+        {
+            sample.minorFaults = static_cast<long long>(memory.PageFaultCount);
+        }
+        IO_COUNTERS io;
+        if (GetProcessIoCounters(GetCurrentProcess(), &io))
+        {
+            sample.writtenBytes = static_cast<long long>(io.WriteTransferCount);
+        }
+#else
+        rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) == 0)
+        {
+            sample.minorFaults = usage.ru_minflt;
+            sample.majorFaults = usage.ru_majflt;
+        }
+        // Bytes this process caused to be sent to storage; missing without task I/O accounting.
+        std::ifstream io("/proc/self/io");
+        std::string name;
+        long long value;
+        while (io >> name >> value)
+        {
+            if (name == "write_bytes:")
+            {
+                sample.writtenBytes = value;
+            }
+        }
+#endif
+        return sample;
+    }
+
+    PagingSample since(const PagingSample& earlier) const
+    {
+        PagingSample delta;
+        delta.minorFaults = minorFaults - earlier.minorFaults;
+        delta.majorFaults = majorFaults - earlier.majorFaults;
+        delta.writtenBytes = writtenBytes - earlier.writtenBytes;
+        return delta;
+    }
+};
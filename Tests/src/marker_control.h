@@ -0,0 +1,12 @@
+#pragma once
+#include <atomic>
+#include "profiled_mutex.h"
+
+// Everything the coordinator and one marker signal each other through. Each block
+// starts on its own cache line, so waking one marker never touches another's flags.
+struct alignas(64) MarkerControl
+{
+    std::atomic<bool> continueSignal{ true };
+    std::atomic<bool> terminateSignal{ false };
+    RunCondition cvContinue;
+};
@@ -0,0 +1,96 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// xoshiro256** seeded through splitmix64, so every marker id gets its own
+// deterministic, well-mixed stream without touching the shared libc rand() state.
+class Xoshiro256StarStar
+{
+public:
+    explicit Xoshiro256StarStar(uint64_t seed)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            seed += 0x9E3779B97F4A7C15ull;
+            uint64_t z = seed;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            state_[i] = z ^ (z >> 31);
+        }
+    }
+
+    uint64_t next()
+    {
+        uint64_t result = rotl(state_[1] * 5, 7) * 9;
+        uint64_t t = state_[1] << 17;
+        state_[2] ^= state_[0];
+        state_[3] ^= state_[1];
+        state_[1] ^= state_[2];
+        state_[0] ^= state_[3];
+        state_[2] ^= t;
+        state_[3] = rotl(state_[3], 45);
+        return result;
+    }
+
+    // Lemire's multiply-shift reduction: unbiased, and the division only runs on the
+    // rare rejected draws.
+    uint32_t below(uint32_t range)
+    {
+        uint64_t product = static_cast<uint64_t>(static_cast<uint32_t>(next() >> 32)) * range;
+        uint32_t low = static_cast<uint32_t>(product);
+        if (low < range)
+        {
+            uint32_t threshold = (0u - range) % range;
+            while (low < threshold)
+            {
+                product = static_cast<uint64_t>(static_cast<uint32_t>(next() >> 32)) * range;
+                low = static_cast<uint32_t>(product);
+            }
+        }
+        return static_cast<uint32_t>(product >> 32);
+    }
+
+    void fillBelow(uint32_t* out, size_t count, uint32_t range)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            out[i] = below(range);
+        }
+    }
+
+private:
+    static uint64_t rotl(uint64_t x, int k)
+    {
+        return (x << k) | (x >> (64 - k));
+    }
+
+    uint64_t state_[4];
+};
+
+// Hands out indices in [0, range) from a pre-generated batch.
+class IndexBatch
+{
+public:
+    static const size_t BatchSize = 64;
+
+    IndexBatch(uint64_t seed, uint32_t range)
+        : rng_(seed), range_(range), position_(BatchSize)
+    {
+    }
+
+    uint32_t next()
+    {
+        if (position_ == BatchSize)
+        {
+            rng_.fillBelow(batch_, BatchSize, range_);
+            position_ = 0;
+        }
+        return batch_[position_++];
+    }
+
+private:
+    Xoshiro256StarStar rng_;
+    uint32_t range_;
+    size_t position_;
+    uint32_t batch_[BatchSize];
+};
@@ -0,0 +1,225 @@
+#pragma once
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include "shared_array.h"
+#include "marker_settings.h"
+#include "marker_control.h"
+#include "ownership_journal.h"
+#include "marker_rng.h"
+#include "task_pool.h"
+
+// Round bookkeeping for pooled markers. A marker that cannot mark parks here and
+// gives its worker back; the coordinator waits until every live marker is parked,
+// the same point the thread version reaches when all markers wait on cvContinue.
+class MarkerRoster
+{
+public:
+    explicit MarkerRoster(int markers)
+        : live_(markers), parked_(0)
+    {
+    }
+
+    std::mutex& mutex()
+    {
+        return mtx_;
+    }
+
+    // Marker side, with mutex() held.
+    void park()
+    {
+        if (++parked_ == live_)
+        {
+            cvAllParked_.notify_one();
+        }
+    }
+
+    // Marker side, with mutex() held, once its cleanup is done.
+    void depart()
+    {
+        --live_;
+        cvAllParked_.notify_one();
+    }
+
+    void waitAllParked()
+    {
+        std::unique_lock<std::mutex> lock(mtx_);
+        cvAllParked_.wait(lock, [this] { return parked_ == live_; });
+    }
+
+    // Coordinator side: one parked marker is about to be resubmitted to terminate.
+    void unparkOne()
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        --parked_;
+    }
+
+    // Coordinator side: every parked marker is about to be resubmitted.
+    void unparkAll()
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        parked_ = 0;
+    }
+
+    int live()
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return live_;
+    }
+
+private:
+    std::mutex mtx_;
+    std::condition_variable cvAllParked_;
+    int live_;
+    int parked_;
+};
+
+// The marker loop as a state machine that runs on a TaskPool. The pauses go through the
+// pool's timer queue when the work model sleeps and run inline otherwise; a blocked
+// marker parks on the roster instead of waiting on a condition variable. A marker may
+// continue on a different worker after every pause, so it cannot hold a mutex across
+// one and always claims cells with CAS, like the thread version's atomic mode.
+template <typename Cell>
+class MarkerTask : public PoolTask
+{
+public:
+    // Marks that may run back to back before the task yields its worker.
+    static const int StepsPerRun = 64;
+
+    MarkerTask(int id, BasicSharedArray<Cell>& array, MarkerControl& control, MarkerRoster& roster,
+        const MarkerSettings& settings = MarkerSettings())
+        : id_(id), array_(array), control_(control), roster_(roster), settings_(settings),
+        counters_(settings.counters != nullptr ? &settings.counters->forMarker(id) : nullptr),
+        indices_(static_cast<uint64_t>(id), static_cast<uint32_t>(array.size()))
+    {
+    }
+
+    void run(TaskPool& pool) override
+    {
+        for (int step = 0; step < StepsPerRun; ++step)
+        {
+            if (state_ == State::Pick)
+            {
+                if (control_.terminateSignal.load(std::memory_order_acquire))
+                {
+                    finish();
+                    return;
+                }
+
+                index_ = indices_.next();
+                if (!cellFree(index_))
+                {
+                    block();
+                    return;
+                }
+                state_ = State::Claim;
+                if (pause(pool))
+                {
+                    return;
+                }
+            }
+
+            if (!array_.claim(index_, id_))
+            {
+                state_ = State::Pick;
+                block();
+                return;
+            }
+            if (settings_.occupancy != nullptr)
+            {
+                settings_.occupancy->set(index_);
+            }
+            journal_.record(index_);
+            ++markedCount_;
+            if (counters_ != nullptr)
+            {
+                MarkerCounters::bump(counters_->marked);
+            }
+
+            state_ = State::Pick;
+            if (pause(pool))
+            {
+                return;
+            }
+        }
+        pool.submit(this);
+    }
+
+private:
+    enum class State
+    {
+        Pick,
+        Claim
+    };
+
+    // Pooled markers claim with CAS, so the cell is read rather than a bitmap bit
+    // that may still lag it.
+    bool cellFree(size_t index) const
+    {
+        return array_.load(index) == 0;
+    }
+
+    // True when the task went to the timer queue and this run has to end.
+    bool pause(TaskPool& pool)
+    {
+        if (settings_.work.kind == WorkKind::Sleep)
+        {
+            pool.submitAfter(this, settings_.work.duration);
+            return true;
+        }
+        settings_.work.perform();
+        return false;
+    }
+
+    void block()
+    {
+        if (counters_ != nullptr)
+        {
+            counters_->noteBlocked();
+        }
+
+        std::lock_guard<std::mutex> lock(roster_.mutex());
+        if (settings_.verbose)
+        {
+            std::cout << "Thread " << id_ << ": marked " << markedCount_ << " elements, cannot mark index " << index_ << std::endl;
+        }
+        control_.continueSignal.store(false);
+        roster_.park();
+    }
+
+    void finish()
+    {
+        journal_.forEach([this](size_t index)
+        {
+            array_.store(index, 0);
+            if (settings_.occupancy != nullptr)
+            {
+                settings_.occupancy->reset(index);
+            }
+        });
+        if (counters_ != nullptr)
+        {
+            MarkerCounters::bump(counters_->released, static_cast<long long>(journal_.size()));
+        }
+
+        std::lock_guard<std::mutex> lock(roster_.mutex());
+        if (settings_.verbose)
+        {
+            std::cout << "Thread " << id_ << ": released " << journal_.size() << " elements" << std::endl;
+        }
+        journal_.clear();
+        roster_.depart();
+    }
+
+    int id_;
+    BasicSharedArray<Cell>& array_;
+    MarkerControl& control_;
+    MarkerRoster& roster_;
+    MarkerSettings settings_;
+    MarkerCounters* counters_;
+    OwnershipJournal journal_;
+    IndexBatch indices_;
+    State state_ = State::Pick;
+    size_t index_ = 0;
+    long long markedCount_ = 0;
+};
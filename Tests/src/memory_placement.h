@@ -0,0 +1,307 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+enum class NumaPolicy
+{
+    None,
+    Interleave,
+    Blocks
+};
+
+enum class HugePages
+{
+    None,
+    Transparent,
+    Explicit
+};
+
+inline const char* numaPolicyName(NumaPolicy policy)
+{
+    switch (policy)
+    {
+    case NumaPolicy::Interleave:
+        return "interleave";
+    case NumaPolicy::Blocks:
+        return "blocks";
+    default:
+        return "none";
+    }
+}
+
+inline const char* hugePagesName(HugePages pages)
+{
+    switch (pages)
+    {
+    case HugePages::Transparent:
+        return "thp";
+    case HugePages::Explicit:
+        return "explicit";
+    default:
+        return "none";
+    }
+}
+
+// Node ids from a /sys node list ("0", "0-1", "0,2-3"); ids need not be contiguous.
+// Empty when the list is malformed.
+inline std::vector<int> parseNodeList(const std::string& list)
+{
+    std::vector<int> nodes;
+    std::stringstream ranges(list);
+    std::string range;
+    try
+    {
+        while (std::getline(ranges, range, ','))
+        {
+            size_t dash = range.find('-');
+            int first = std::stoi(range.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for (int node = first; node <= last; ++node)
+            {
+                nodes.push_back(node);
+            }
+        }
+    }
+    catch (const std::exception&)
+    {
+        nodes.clear();
+    }
+    return nodes;
+}
+
+// Online NUMA node ids; node 0 alone when /sys does not say.
+inline std::vector<int> onlineNumaNodes()
+{
+    std::ifstream online("/sys/devices/system/node/online");
+    std::string list;
+    std::vector<int> nodes;
+    if (online >> list)
+    {
+        nodes = parseNodeList(list);
+    }
+    if (nodes.empty())
+    {
+        nodes.push_back(0);
+    }
+    return nodes;
+}
+
+// mbind node mask with one bit per node id. Ids past the width of the mask are left
+// out; the policies only use the nodes the mask can name.
+inline unsigned long numaNodeMask(const std::vector<int>& nodes)
+{
+    const int maskBits = static_cast<int>(sizeof(unsigned long) * 8);
+    unsigned long mask = 0;
+    for (int node : nodes)
+    {
+        if (node >= 0 && node < maskBits)
+        {
+            mask |= 1ul << node;
+        }
+    }
+    return mask;
+}
+
+// Anonymous zeroed memory whose pages are placed before anybody touches them:
+// interleaved round-robin over all nodes, or cut into one contiguous block per node,
+// optionally on 2 MB pages. The markers' first touch then lands where the policy says
+// instead of on the node of the thread that allocated the array.
+class PlacedBuffer
+{
+public:
+    static const size_t HugePageBytes = 2 * 1024 * 1024;
+
+    PlacedBuffer(size_t bytes, NumaPolicy numa, HugePages huge)
+        : numa_(numa), huge_(huge), nodes_(onlineNumaNodes())
+    {
+        size_t granule = huge == HugePages::None ? pageBytes() : HugePageBytes;
+        bytes_ = (bytes + granule - 1) / granule * granule;
+        if (bytes_ == 0)
+        {
+            bytes_ = granule;
+        }
+        allocate();
+        numaApplied_ = applyNuma(granule);
+    }
+
+    PlacedBuffer(const PlacedBuffer&) = delete;
+    PlacedBuffer& operator=(const PlacedBuffer&) = delete;
+
+    ~PlacedBuffer()
+    {
+#ifdef _WIN32
+        VirtualFree(data_, 0, MEM_RELEASE);
+#else
+        ::munmap(data_, bytes_);
+#endif
+    }
+
+    void* data() const
+    {
+        return data_;
+    }
+
+    size_t bytes() const
+    {
+        return bytes_;
+    }
+
+    NumaPolicy numa() const
+    {
+        return numa_;
+    }
+
+    HugePages hugePages() const
+    {
+        return huge_;
+    }
+
+    int nodes() const
+    {
+        return static_cast<int>(nodes_.size());
+    }
+
+    // False when the policy could not be set, e.g. on a kernel without NUMA support.
+    bool numaApplied() const
+    {
+        return numaApplied_;
+    }
+
+    // Transparent huge pages the process currently holds, in kB; -1 when unknown.
+    static long long anonHugePagesKb()
+    {
+        std::ifstream rollup("/proc/self/smaps_rollup");
+        std::string name;
+        while (rollup >> name)
+        {
+            long long value;
+            if (name == "AnonHugePages:" && rollup >> value)
+            {
+                return value;
+            }
+        }
+        return -1;
+    }
+
+private:
+    static size_t pageBytes()
+    {
+#ifdef _WIN32
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        return info.dwPageSize;
+#else
+        return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+    }
+
+    void allocate()
+    {
+#ifdef _WIN32
+        DWORD flags = MEM_RESERVE | MEM_COMMIT;
+        if (huge_ == HugePages::Explicit)
+        {
+            flags |= MEM_LARGE_PAGES;
+        }
+        data_ = VirtualAlloc(NULL, bytes_, flags, PAGE_READWRITE);
+        if (data_ == NULL)
+        {
+            throw std::invalid_argument(huge_ == HugePages::Explicit
+                ? "Cannot allocate large pages; the account needs the 'Lock pages in memory' privilege."
+                : "Cannot allocate the array.");
+        }
+#else
+        // Explicit huge pages are reserved up front, so a short pool fails here and not
+        // with SIGBUS on first touch.
+        int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+        flags |= huge_ == HugePages::Explicit ? MAP_HUGETLB : MAP_NORESERVE;
+        data_ = ::mmap(nullptr, bytes_, PROT_READ | PROT_WRITE, flags, -1, 0);
+        if (data_ == MAP_FAILED)
+        {
+            data_ = nullptr;
+            throw std::invalid_argument(huge_ == HugePages::Explicit
+                ? "Cannot map explicit huge pages; reserve them in /proc/sys/vm/nr_hugepages or use --huge-pages thp."
+                : "Cannot allocate the array.");
+        }
+#ifdef MADV_HUGEPAGE
+        if (huge_ == HugePages::Transparent)
+        {
+            ::madvise(data_, bytes_, MADV_HUGEPAGE);
+        }
+#endif
+#endif
+    }
+
+    bool applyNuma(size_t granule)
+    {
+        if (numa_ == NumaPolicy::None)
+        {
+            return true;
+        }
+#if defined(__linux__) && defined(SYS_mbind)
+        const int bindMode = 2;
+        const int interleaveMode = 3;
+        const unsigned long maskBits = sizeof(unsigned long) * 8;
+        std::vector<int> usable;
+        for (int node : nodes_)
+        {
+            if (node >= 0 && node < static_cast<int>(maskBits))
+            {
+                usable.push_back(node);
+            }
+        }
+        if (usable.empty())
+        {
+            return false;
+        }
+
+        if (numa_ == NumaPolicy::Interleave)
+        {
+            unsigned long mask = numaNodeMask(usable);
+            return ::syscall(SYS_mbind, data_, bytes_, interleaveMode, &mask, maskBits + 1, 0) == 0;
+        }
+
+        // Block i goes to the i-th online node, whatever its id.
+        size_t granules = bytes_ / granule;
+        size_t perNode = (granules + usable.size() - 1) / usable.size();
+        bool applied = true;
+        for (size_t i = 0; i < usable.size(); ++i)
+        {
+            size_t first = perNode * i;
+            if (first >= granules)
+            {
+                break;
+            }
+            size_t count = first + perNode <= granules ? perNode : granules - first;
+            unsigned long mask = numaNodeMask({ usable[i] });
+            char* block = static_cast<char*>(data_) + first * granule;
+            applied = ::syscall(SYS_mbind, block, count * granule, bindMode, &mask, maskBits + 1, 0) == 0 && applied;
+        }
+        return applied;
+#else
+        return false;
+#endif
+    }
+
+    NumaPolicy numa_;
+    HugePages huge_;
+    std::vector<int> nodes_;
+    size_t bytes_ = 0;
+    void* data_ = nullptr;
+    bool numaApplied_ = false;
+};
@@ -0,0 +1,123 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// One bit per array cell, set while the cell is owned. Free/occupied questions read
+// 64 cells per word with popcount and ctz instead of touching the 4-byte cells.
+// The bits follow the cells under the same lock (or right after the CAS), so they
+// may lag the array only while a marker is between the two updates.
+class OccupancyBitmap
+{
+public:
+    explicit OccupancyBitmap(size_t size)
+        : size_(size), wordCount_((size + 63) / 64), words_(new std::atomic<uint64_t>[wordCount_])
+    {
+        for (size_t w = 0; w < wordCount_; ++w)
+        {
+            words_[w].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    size_t size() const
+    {
+        return size_;
+    }
+
+    size_t memoryBytes() const
+    {
+        return wordCount_ * sizeof(uint64_t);
+    }
+
+    void set(size_t index)
+    {
+        words_[index / 64].fetch_or(bit(index), std::memory_order_relaxed);
+    }
+
+    void reset(size_t index)
+    {
+        words_[index / 64].fetch_and(~bit(index), std::memory_order_relaxed);
+    }
+
+    bool test(size_t index) const
+    {
+        return (words_[index / 64].load(std::memory_order_relaxed) & bit(index)) != 0;
+    }
+
+    size_t occupied() const
+    {
+        size_t count = 0;
+        for (size_t w = 0; w < wordCount_; ++w)
+        {
+            count += popCount(words_[w].load(std::memory_order_relaxed));
+        }
+        return count;
+    }
+
+    size_t freeCells() const
+    {
+        return size_ - occupied();
+    }
+
+    bool saturated() const
+    {
+        return occupied() == size_;
+    }
+
+    // First free cell at or after `from`, or size() when there is none.
+    size_t nextFree(size_t from) const
+    {
+        if (from >= size_)
+        {
+            return size_;
+        }
+
+        size_t w = from / 64;
+        uint64_t freeBits = ~words_[w].load(std::memory_order_relaxed) & (~0ull << (from % 64));
+        while (freeBits == 0)
+        {
+            if (++w == wordCount_)
+            {
+                return size_;
+            }
+            freeBits = ~words_[w].load(std::memory_order_relaxed);
+        }
+
+        size_t index = w * 64 + trailingZeros(freeBits);
+        return index < size_ ? index : size_;
+    }
+
+private:
+    static uint64_t bit(size_t index)
+    {
+        return 1ull << (index % 64);
+    }
+
+    static size_t popCount(uint64_t word)
+    {
+#ifdef _MSC_VER
+        return static_cast<size_t>(__popcnt64(word));
+#else
+        return static_cast<size_t>(__builtin_popcountll(word));
+#endif
+    }
+
+    static size_t trailingZeros(uint64_t word)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward64(&index, word);
+        return static_cast<size_t>(index);
+#else
+        return static_cast<size_t>(__builtin_ctzll(word));
+#endif
+    }
+
+    size_t size_;
+    size_t wordCount_;
+    std::unique_ptr<std::atomic<uint64_t>[]> words_;
+};
@@ -0,0 +1,52 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Indices a marker has claimed, kept in fixed-size chunks so that appending never
+// copies what is already recorded. Cleanup walks this list instead of the whole array.
+class OwnershipJournal
+{
+public:
+    static const size_t ChunkSize = 1024;
+
+    void record(size_t index)
+    {
+        if (size_ % ChunkSize == 0)
+        {
+            chunks_.emplace_back(new uint32_t[ChunkSize]);
+        }
+        chunks_.back()[size_ % ChunkSize] = static_cast<uint32_t>(index);
+        ++size_;
+    }
+
+    template <typename Visitor>
+    void forEach(Visitor visit) const
+    {
+        for (size_t i = 0; i < size_; ++i)
+        {
+            visit(static_cast<size_t>(chunks_[i / ChunkSize][i % ChunkSize]));
+        }
+    }
+
+    void clear()
+    {
+        std::vector<std::unique_ptr<uint32_t[]>>().swap(chunks_);
+        size_ = 0;
+    }
+
+    size_t size() const
+    {
+        return size_;
+    }
+
+    size_t memoryBytes() const
+    {
+        return chunks_.size() * ChunkSize * sizeof(uint32_t) + chunks_.capacity() * sizeof(chunks_[0]);
+    }
+
+private:
+    std::vector<std::unique_ptr<uint32_t[]>> chunks_;
+    size_t size_ = 0;
+};
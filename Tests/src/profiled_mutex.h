@@ -0,0 +1,170 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <thread>
+
+// Durations in power-of-two nanosecond buckets: bucket b holds values below 2^b ns.
+class LatencyHistogram
+{
+public:
+    static const int Buckets = 48;
+
+    void record(long long ns)
+    {
+        int bucket = 0;
+        while (bucket < Buckets - 1 && (1ll << bucket) <= ns)
+        {
+            ++bucket;
+        }
+        ++counts_[bucket];
+        ++count_;
+        totalNs_ += ns;
+        maxNs_ = ns > maxNs_ ? ns : maxNs_;
+    }
+
+    long long count() const
+    {
+        return count_;
+    }
+
+    long long totalNs() const
+    {
+        return totalNs_;
+    }
+
+    long long maxNs() const
+    {
+        return maxNs_;
+    }
+
+    // Upper bound of the bucket holding the given fraction of the samples, capped at
+    // the largest sample.
+    long long percentileNs(double fraction) const
+    {
+        long long rank = static_cast<long long>(fraction * count_);
+        long long seen = 0;
+        for (int bucket = 0; bucket < Buckets; ++bucket)
+        {
+            seen += counts_[bucket];
+            if (seen > rank)
+            {
+                return (1ll << bucket) < maxNs_ ? 1ll << bucket : maxNs_;
+            }
+        }
+        return maxNs_;
+    }
+
+    void print(const char* name, std::ostream& out) const
+    {
+        out << name << " count=" << count_ << " total_ms=" << totalNs_ / 1e6 << " p50_ns<=" << percentileNs(0.5)
+            << " p90_ns<=" << percentileNs(0.9) << " p99_ns<=" << percentileNs(0.99) << " max_ns=" << maxNs_ << std::endl;
+    }
+
+private:
+    long long counts_[Buckets] = {};
+    long long count_ = 0;
+    long long totalNs_ = 0;
+    long long maxNs_ = 0;
+};
+
+// A std::mutex that measures how long each lock() waited, how long the lock was then
+// held and how often it passed to a different thread. Everything is recorded while
+// the mutex is held, so the statistics need no synchronization of their own. Works
+// with std::condition_variable_any, whose waits show up as an unlock and a lock.
+class ProfiledMutex
+{
+public:
+    ProfiledMutex() = default;
+    ProfiledMutex(const ProfiledMutex&) = delete;
+    ProfiledMutex& operator=(const ProfiledMutex&) = delete;
+
+    void lock()
+    {
+        auto start = std::chrono::steady_clock::now();
+        bool contended = !mtx_.try_lock();
+        if (contended)
+        {
+            mtx_.lock();
+        }
+        acquired(start, contended);
+    }
+
+    bool try_lock()
+    {
+        if (!mtx_.try_lock())
+        {
+            return false;
+        }
+        acquired(std::chrono::steady_clock::now(), false);
+        return true;
+    }
+
+    void unlock()
+    {
+        hold_.record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - heldSince_).count());
+        mtx_.unlock();
+    }
+
+    // Read once the threads that use the mutex are gone, or with it held.
+    const LatencyHistogram& waits() const
+    {
+        return wait_;
+    }
+
+    const LatencyHistogram& holds() const
+    {
+        return hold_;
+    }
+
+    long long contended() const
+    {
+        return contended_;
+    }
+
+    long long handoffs() const
+    {
+        return handoffs_;
+    }
+
+    void report(std::ostream& out) const
+    {
+        out << "lock_profile acquisitions=" << wait_.count() << " contended=" << contended_ << " handoffs=" << handoffs_ << std::endl;
+        wait_.print("lock_wait", out);
+        hold_.print("lock_hold", out);
+    }
+
+private:
+    void acquired(std::chrono::steady_clock::time_point start, bool contended)
+    {
+        heldSince_ = std::chrono::steady_clock::now();
+        wait_.record(std::chrono::duration_cast<std::chrono::nanoseconds>(heldSince_ - start).count());
+        contended_ += contended ? 1 : 0;
+
+        std::thread::id owner = std::this_thread::get_id();
+        handoffs_ += owner != lastOwner_ && lastOwner_ != std::thread::id() ? 1 : 0;
+        lastOwner_ = owner;
+    }
+
+    std::mutex mtx_;
+    LatencyHistogram wait_;
+    LatencyHistogram hold_;
+    std::chrono::steady_clock::time_point heldSince_;
+    std::thread::id lastOwner_;
+    long long contended_ = 0;
+    long long handoffs_ = 0;
+};
+
+// The run's shared mutex and the condition variables used with it. Building with
+// LAB3_PROFILE_LOCKS swaps in the profiled mutex; otherwise these are the plain std
+// types and the profiler costs nothing.
+#ifdef LAB3_PROFILE_LOCKS
+typedef ProfiledMutex RunMutex;
+typedef std::condition_variable_any RunCondition;
+#else
+typedef std::mutex RunMutex;
+typedef std::condition_variable RunCondition;
+#endif
+typedef std::unique_lock<RunMutex> RunLock;
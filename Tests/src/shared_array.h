@@ -0,0 +1,127 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include "mapped_file.h"
+#include "memory_placement.h"
+
+enum class LockMode
+{
+    Global,
+    Striped,
+    Atomic
+};
+
+// Contiguous buffer of atomic cells shared by all markers. Lock-based modes use
+// relaxed loads and stores under their mutexes; the lock-free mode claims cells with CAS.
+// Cell only has to hold the largest marker id, so runs with few markers use 1 or 2 bytes
+// per cell; the interface still speaks int.
+template <typename Cell>
+class BasicSharedArray
+{
+public:
+    typedef Cell CellType;
+
+    explicit BasicSharedArray(size_t size)
+        : BasicSharedArray(size, std::string())
+    {
+    }
+
+    // Cells live in `mapPath` instead of the heap when the path is not empty. The
+    // freshly truncated file already reads as zeroes, so nothing is written up front.
+    // A NUMA policy or huge pages move a heap array into placed anonymous memory,
+    // which is left untouched so the markers' first touch follows the policy.
+    BasicSharedArray(size_t size, const std::string& mapPath, NumaPolicy numa = NumaPolicy::None, HugePages huge = HugePages::None)
+        : size_(size)
+    {
+        // C++20 atomics value-initialize, which for a zero page is the state already there.
+        static_assert(std::is_trivially_destructible<std::atomic<Cell>>::value, "external cells are used without construction");
+        static_assert(sizeof(std::atomic<Cell>) == sizeof(Cell), "external cells must have the layout of plain cells");
+        if (!mapPath.empty())
+        {
+            mapping_.reset(new MappedFile(mapPath, size * sizeof(Cell)));
+            cells_ = static_cast<std::atomic<Cell>*>(mapping_->data());
+        }
+        else if (numa != NumaPolicy::None || huge != HugePages::None)
+        {
+            placed_.reset(new PlacedBuffer(size * sizeof(Cell), numa, huge));
+            cells_ = static_cast<std::atomic<Cell>*>(placed_->data());
+        }
+        else
+        {
+            owned_.reset(new std::atomic<Cell>[size]);
+            cells_ = owned_.get();
+            for (size_t i = 0; i < size_; ++i)
+            {
+                cells_[i].store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // The backing file, or nullptr for a heap array.
+    MappedFile* mapping() const
+    {
+        return mapping_.get();
+    }
+
+    // The placed anonymous memory, or nullptr when the array uses plain heap or a file.
+    const PlacedBuffer* placement() const
+    {
+        return placed_.get();
+    }
+
+    size_t size() const
+    {
+        return size_;
+    }
+
+    int load(size_t index) const
+    {
+        return static_cast<int>(cells_[index].load(std::memory_order_relaxed));
+    }
+
+    void store(size_t index, int value)
+    {
+        cells_[index].store(static_cast<Cell>(value), std::memory_order_release);
+    }
+
+    bool claim(size_t index, int id)
+    {
+        Cell expected = 0;
+        return cells_[index].compare_exchange_strong(expected, static_cast<Cell>(id), std::memory_order_acq_rel, std::memory_order_relaxed);
+    }
+
+    std::atomic<Cell>& operator[](size_t index)
+    {
+        return cells_[index];
+    }
+
+    // Plain view of the cells for bulk scans while no marker is writing.
+    const Cell* raw() const
+    {
+        static_assert(sizeof(std::atomic<Cell>) == sizeof(Cell), "atomic cells must have the layout of plain cells");
+        return reinterpret_cast<const Cell*>(cells_);
+    }
+
+    const std::atomic<Cell>* begin() const
+    {
+        return cells_;
+    }
+
+    const std::atomic<Cell>* end() const
+    {
+        return cells_ + size_;
+    }
+
+private:
+    size_t size_;
+    std::unique_ptr<std::atomic<Cell>[]> owned_;
+    std::unique_ptr<MappedFile> mapping_;
+    std::unique_ptr<PlacedBuffer> placed_;
+    std::atomic<Cell>* cells_ = nullptr;
+};
+
+typedef BasicSharedArray<uint32_t> SharedArray;
@@ -0,0 +1,55 @@
+#pragma once
+#include <cstddef>
+#include <mutex>
+#include <vector>
+#include <stdexcept>
+
+// Each mutex sits on its own cache line so neighbouring stripes do not false-share.
+struct alignas(64) PaddedMutex
+{
+    std::mutex mtx;
+};
+
+class StripedLocks
+{
+public:
+    StripedLocks(size_t arraySize, size_t stripeCount)
+    {
+        if (arraySize == 0 || stripeCount == 0)
+        {
+            throw std::invalid_argument("Array size and stripe count must be positive.");
+        }
+
+        if (stripeCount > arraySize)
+        {
+            stripeCount = arraySize;
+        }
+
+        stripeSize_ = (arraySize + stripeCount - 1) / stripeCount;
+        stripes_ = std::vector<PaddedMutex>((arraySize + stripeSize_ - 1) / stripeSize_);
+    }
+
+    std::mutex& forIndex(size_t index)
+    {
+        return stripes_[index / stripeSize_].mtx;
+    }
+
+    std::mutex& stripe(size_t stripeIndex)
+    {
+        return stripes_[stripeIndex].mtx;
+    }
+
+    size_t count() const
+    {
+        return stripes_.size();
+    }
+
+    size_t stripeSize() const
+    {
+        return stripeSize_;
+    }
+
+private:
+    size_t stripeSize_;
+    std::vector<PaddedMutex> stripes_;
+};
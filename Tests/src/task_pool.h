@@ -0,0 +1,244 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+class TaskPool;
+
+// A unit of work that runs one step at a time. A step ends by resubmitting the task,
+// handing it to the timer queue, or by parking it somewhere the pool does not know about.
+class PoolTask
+{
+public:
+    virtual ~PoolTask()
+    {
+    }
+
+    virtual void run(TaskPool& pool) = 0;
+};
+
+// Fixed set of workers, each with its own deque: a worker pushes and pops at the back
+// of its own deque and steals from the front of the others when it runs dry. A timer
+// thread submits delayed tasks when they are due, so nothing in the pool sleeps
+// while holding a worker.
+class TaskPool
+{
+public:
+    explicit TaskPool(unsigned workers)
+        : pending_(0), steals_(0), nextQueue_(0), stop_(false), timerSequence_(0)
+    {
+        if (workers == 0)
+        {
+            workers = 1;
+        }
+        for (unsigned i = 0; i < workers; ++i)
+        {
+            queues_.emplace_back(new WorkerQueue());
+        }
+        for (unsigned i = 0; i < workers; ++i)
+        {
+            threads_.emplace_back([this, i] { workerLoop(i); });
+        }
+        timer_ = std::thread([this] { timerLoop(); });
+    }
+
+    TaskPool(const TaskPool&) = delete;
+    TaskPool& operator=(const TaskPool&) = delete;
+
+    ~TaskPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(idleMtx_);
+            stop_ = true;
+        }
+        cvIdle_.notify_all();
+        {
+            std::lock_guard<std::mutex> lock(timerMtx_);
+        }
+        cvTimer_.notify_all();
+
+        for (auto& thread : threads_)
+        {
+            thread.join();
+        }
+        timer_.join();
+    }
+
+    // From a worker the task goes to that worker's own deque, otherwise round-robin.
+    void submit(PoolTask* task)
+    {
+        WorkerSlot& slot = currentWorker();
+        size_t index = slot.pool == this ? slot.index : nextQueue_.fetch_add(1) % queues_.size();
+        {
+            std::lock_guard<std::mutex> lock(queues_[index]->mtx);
+            queues_[index]->tasks.push_back(task);
+        }
+        pending_.fetch_add(1);
+        {
+            std::lock_guard<std::mutex> lock(idleMtx_);
+        }
+        cvIdle_.notify_one();
+    }
+
+    void submitAfter(PoolTask* task, std::chrono::microseconds delay)
+    {
+        {
+            std::lock_guard<std::mutex> lock(timerMtx_);
+            timers_.push(Timer{ std::chrono::steady_clock::now() + delay, timerSequence_++, task });
+        }
+        cvTimer_.notify_one();
+    }
+
+    size_t workers() const
+    {
+        return threads_.size();
+    }
+
+    std::vector<std::thread>& threads()
+    {
+        return threads_;
+    }
+
+    long long steals() const
+    {
+        return steals_.load();
+    }
+
+private:
+    struct alignas(64) WorkerQueue
+    {
+        std::mutex mtx;
+        std::deque<PoolTask*> tasks;
+    };
+
+    struct Timer
+    {
+        std::chrono::steady_clock::time_point due;
+        unsigned long long sequence;
+        PoolTask* task;
+
+        bool operator>(const Timer& other) const
+        {
+            return due != other.due ? due > other.due : sequence > other.sequence;
+        }
+    };
+
+    struct WorkerSlot
+    {
+        TaskPool* pool;
+        size_t index;
+    };
+
+    static WorkerSlot& currentWorker()
+    {
+        thread_local WorkerSlot slot = { nullptr, 0 };
+        return slot;
+    }
+
+    PoolTask* take(size_t index)
+    {
+        {
+            WorkerQueue& own = *queues_[index];
+            std::lock_guard<std::mutex> lock(own.mtx);
+            if (!own.tasks.empty())
+            {
+                PoolTask* task = own.tasks.back();
+                own.tasks.pop_back();
+                return task;
+            }
+        }
+
+        for (size_t offset = 1; offset < queues_.size(); ++offset)
+        {
+            WorkerQueue& victim = *queues_[(index + offset) % queues_.size()];
+            std::lock_guard<std::mutex> lock(victim.mtx);
+            if (!victim.tasks.empty())
+            {
+                PoolTask* task = victim.tasks.front();
+                victim.tasks.pop_front();
+                steals_.fetch_add(1, std::memory_order_relaxed);
+                return task;
+            }
+        }
+        return nullptr;
+    }
+
+    void workerLoop(size_t index)
+    {
+        currentWorker() = WorkerSlot{ this, index };
+        while (true)
+        {
+            PoolTask* task = take(index);
+            if (task != nullptr)
+            {
+                pending_.fetch_sub(1);
+                task->run(*this);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(idleMtx_);
+            cvIdle_.wait(lock, [this] { return pending_.load() > 0 || stop_; });
+            if (stop_)
+            {
+                return;
+            }
+        }
+    }
+
+    void timerLoop()
+    {
+        std::unique_lock<std::mutex> lock(timerMtx_);
+        while (true)
+        {
+            {
+                std::lock_guard<std::mutex> idle(idleMtx_);
+                if (stop_)
+                {
+                    return;
+                }
+            }
+
+            if (timers_.empty())
+            {
+                cvTimer_.wait(lock);
+                continue;
+            }
+
+            auto due = timers_.top().due;
+            if (std::chrono::steady_clock::now() < due)
+            {
+                cvTimer_.wait_until(lock, due);
+                continue;
+            }
+
+            PoolTask* task = timers_.top().task;
+            timers_.pop();
+            lock.unlock();
+            submit(task);
+            lock.lock();
+        }
+    }
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues_;
+    std::vector<std::thread> threads_;
+    std::thread timer_;
+    std::atomic<long long> pending_;
+    std::atomic<long long> steals_;
+    std::atomic<size_t> nextQueue_;
+
+    std::mutex idleMtx_;
+    std::condition_variable cvIdle_;
+    bool stop_;
+
+    std::mutex timerMtx_;
+    std::condition_variable cvTimer_;
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers_;
+    unsigned long long timerSequence_;
+};
@@ -0,0 +1,104 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "marker_control.h"
+#include "marker_counters.h"
+#include "marker_rng.h"
+
+enum class VictimPolicy
+{
+    Prompt,
+    RoundRobin,
+    MostMarks,
+    FewestMarks,
+    Random,
+    OldestBlocked
+};
+
+inline const char* victimPolicyName(VictimPolicy policy)
+{
+    switch (policy)
+    {
+    case VictimPolicy::RoundRobin:
+        return "round-robin";
+    case VictimPolicy::MostMarks:
+        return "most";
+    case VictimPolicy::FewestMarks:
+        return "fewest";
+    case VictimPolicy::Random:
+        return "random";
+    case VictimPolicy::OldestBlocked:
+        return "oldest";
+    default:
+        return "prompt";
+    }
+}
+
+// Chooses the round's victim among the markers whose terminate flag is still clear,
+// so a run can drain without anybody at the prompt. Ties go to the lowest id.
+class VictimPicker
+{
+public:
+    VictimPicker(VictimPolicy policy, uint64_t seed)
+        : policy_(policy), rng_(seed), last_(0)
+    {
+    }
+
+    // 0 when no marker is left.
+    int next(const std::vector<MarkerControl>& controls, const CounterBoard& counters)
+    {
+        std::vector<int> live;
+        int count = static_cast<int>(controls.size());
+        for (int offset = 1; offset <= count; ++offset)
+        {
+            // Round-robin starts right after the previous victim, the others at id 1.
+            int id = policy_ == VictimPolicy::RoundRobin ? (last_ + offset - 1) % count + 1 : offset;
+            if (!controls[id - 1].terminateSignal.load())
+            {
+                live.push_back(id);
+            }
+        }
+        if (live.empty())
+        {
+            return 0;
+        }
+
+        int victim = live.front();
+        switch (policy_)
+        {
+        case VictimPolicy::Random:
+            victim = live[rng_.below(static_cast<uint32_t>(live.size()))];
+            break;
+        case VictimPolicy::MostMarks:
+        case VictimPolicy::FewestMarks:
+            for (int id : live)
+            {
+                long long marks = counters.forMarker(id).marked.load();
+                long long best = counters.forMarker(victim).marked.load();
+                if (policy_ == VictimPolicy::MostMarks ? marks > best : marks < best)
+                {
+                    victim = id;
+                }
+            }
+            break;
+        case VictimPolicy::OldestBlocked:
+            for (int id : live)
+            {
+                if (counters.forMarker(id).blockedAt.load() < counters.forMarker(victim).blockedAt.load())
+                {
+                    victim = id;
+                }
+            }
+            break;
+        default:
+            break;
+        }
+        last_ = victim;
+        return victim;
+    }
+
+private:
+    VictimPolicy policy_;
+    Xoshiro256StarStar rng_;
+    int last_;
+};
@@ -0,0 +1,105 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+enum class WorkKind
+{
+    None,
+    Yield,
+    Spin,
+    Hash,
+    Sleep
+};
+
+// What a marker does in each of the two pauses around a mark. Sleep is the lab's
+// classic 5 ms; the others expose lock overhead or CPU-bound scaling instead.
+struct WorkModel
+{
+    WorkKind kind = WorkKind::Sleep;
+    std::chrono::microseconds duration = std::chrono::microseconds(5000);
+    size_t hashBytes = 4096;
+
+    void perform() const
+    {
+        switch (kind)
+        {
+        case WorkKind::None:
+            break;
+        case WorkKind::Yield:
+            std::this_thread::yield();
+            break;
+        case WorkKind::Spin:
+            spin(duration);
+            break;
+        case WorkKind::Hash:
+            hash(hashBytes);
+            break;
+        case WorkKind::Sleep:
+            std::this_thread::sleep_for(duration);
+            break;
+        }
+    }
+
+    // Busy loop iterations per microsecond, measured once per process so the spin
+    // itself does not have to read the clock.
+    static uint64_t spinIterationsPerMicrosecond()
+    {
+        static const uint64_t calibrated = calibrateSpin();
+        return calibrated;
+    }
+
+    static void spin(std::chrono::microseconds time)
+    {
+        spinIterations(spinIterationsPerMicrosecond() * static_cast<uint64_t>(time.count()));
+    }
+
+    // FNV-1a over a per-thread buffer; stands in for a CPU-bound payload.
+    static uint64_t hash(size_t bytes)
+    {
+        thread_local std::vector<unsigned char> buffer;
+        if (buffer.size() < bytes)
+        {
+            buffer.resize(bytes);
+            for (size_t i = 0; i < bytes; ++i)
+            {
+                buffer[i] = static_cast<unsigned char>(i * 31);
+            }
+        }
+
+        uint64_t h = 0xCBF29CE484222325ull;
+        for (size_t i = 0; i < bytes; ++i)
+        {
+            h = (h ^ buffer[i]) * 0x100000001B3ull;
+        }
+        sink() = h;
+        return h;
+    }
+
+private:
+    static void spinIterations(uint64_t count)
+    {
+        for (uint64_t i = 0; i < count; ++i)
+        {
+            sink() = i;
+        }
+    }
+
+    static uint64_t calibrateSpin()
+    {
+        const uint64_t probe = 1 << 20;
+        auto start = std::chrono::steady_clock::now();
+        spinIterations(probe);
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+        uint64_t perMicrosecond = probe / static_cast<uint64_t>(elapsed.count() > 0 ? elapsed.count() : 1);
+        return perMicrosecond > 0 ? perMicrosecond : 1;
+    }
+
+    static volatile uint64_t& sink()
+    {
+        thread_local volatile uint64_t value = 0;
+        return value;
+    }
+};